@@ -0,0 +1,243 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Microbenchmarks of the evaluation, move generation and search on the positions in
+// tests/data/corpus.h, reported as JSON on stdout:
+//
+//   gomoku_bench [-t <min_time_ms>] [-f <filter>]
+//
+// Each benchmark is repeated until it has run for at least min_time_ms (default 500).
+// Built with BLUPIG_TEST so that the private stages of RenjuAIEval and RenjuAINegamax
+// can be measured on their own.
+
+#include <ai/eval.h>
+#include <ai/negamax.h>
+#include <ai/search_context.h>
+#include <api/renju_api.h>
+#include <data/corpus.h>
+#include <utils/json.h>
+#include <utils/stats.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Results are accumulated here so the measured calls cannot be optimized away
+static volatile int g_bench_sink = 0;
+
+// A decoded corpus position with its search context
+struct BenchPosition {
+    const RenjuCorpusPosition *corpus;
+    std::vector<char> gs;
+    std::unique_ptr<RenjuAISearchContext> ctx;
+
+    // Four direction measurements of every empty cell, the input of matchPattern
+    std::vector<RenjuAIEval::DirectionMeasurement> adms;
+};
+
+// Run one pass of a benchmark, returning the number of operations performed
+typedef long long (*BenchPass)(BenchPosition *position);
+
+static long long evalMovePass(BenchPosition *position) {
+    RenjuAISearchContext *ctx = position->ctx.get();
+    long long ops = 0;
+    int sum = 0;
+    for (int r = 0; r < ctx->board_size; ++r) {
+        for (int c = 0; c < ctx->board_size; ++c) {
+            if (ctx->board.cell(r, c) != 0) continue;
+            sum += RenjuAIEval::evalMove(ctx, ctx->board, r, c, 1);
+            sum += RenjuAIEval::evalMove(ctx, ctx->board, r, c, 2);
+            ops += 2;
+        }
+    }
+    g_bench_sink += sum;
+    return ops;
+}
+
+static long long measureDirectionPass(BenchPosition *position) {
+    RenjuAISearchContext *ctx = position->ctx.get();
+    const char *gs = position->gs.data();
+    long long ops = 0;
+    int sum = 0;
+    RenjuAIEval::DirectionMeasurement dm;
+    for (int r = 0; r < ctx->board_size; ++r) {
+        for (int c = 0; c < ctx->board_size; ++c) {
+            if (gs[ctx->board_size * r + c] != 0) continue;
+            for (int d = 0; d < 4; ++d) {
+                const int *direction = RenjuAIEval::line_directions[d];
+                RenjuAIEval::measureDirection(ctx, gs, r, c, direction[0], direction[1], 1, false, &dm);
+                sum += dm.length;
+                RenjuAIEval::measureDirection(ctx, gs, r, c, direction[0], direction[1], 1, true, &dm);
+                sum += dm.length;
+                ops += 2;
+            }
+        }
+    }
+    g_bench_sink += sum;
+    return ops;
+}
+
+static long long matchPatternPass(BenchPosition *position) {
+    RenjuAISearchContext *ctx = position->ctx.get();
+    long long ops = 0;
+    int sum = 0;
+    for (size_t i = 0; i < position->adms.size(); i += 4) {
+        for (int j = 0; j < kRenjuAiEvalPresetPatternsSize; ++j) {
+            sum += RenjuAIEval::matchPattern(ctx, &position->adms[i], &RenjuAIEval::preset_patterns[2 * j]);
+        }
+        ops += kRenjuAiEvalPresetPatternsSize;
+    }
+    g_bench_sink += sum;
+    return ops;
+}
+
+// Move generation on a board whose heuristic cache is warm, as it is inside the search
+static long long searchMovesOrderedPass(BenchPosition *position) {
+    RenjuAISearchContext *ctx = position->ctx.get();
+    RenjuAIMoveList &moves = ctx->plies[0].moves_player;
+    g_bench_sink += RenjuAINegamax::searchMovesOrdered(ctx, position->corpus->player, &moves);
+    return 1;
+}
+
+// Time passes of a benchmark until min_time_ms has passed
+static void runBenchmark(const char *name, BenchPass pass, std::vector<BenchPosition> *positions,
+                         long long min_time_ms, nlohmann::json *output) {
+    for (auto &position : *positions) {
+        pass(&position);  // Warm up
+
+        long long ops = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto now = start;
+        do {
+            ops += pass(&position);
+            now = std::chrono::steady_clock::now();
+        } while (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() < min_time_ms);
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+
+        nlohmann::json result;
+        result["name"] = name;
+        result["position"] = position.corpus->name;
+        result["ops"] = ops;
+        result["ns_per_op"] = ns / ops;
+        result["ops_per_sec"] = ops / ns * 1e9;
+        output->push_back(result);
+    }
+}
+
+// Fixed-depth search from a cold transposition table, repeated until min_time_ms has passed
+static void runSearchBenchmark(std::vector<BenchPosition> *positions, long long min_time_ms, nlohmann::json *output) {
+    for (auto &position : *positions) {
+        const RenjuCorpusPosition *corpus = position.corpus;
+        RenjuAISearchContext *ctx = position.ctx.get();
+
+        long long nodes = 0, searches = 0;
+        uint64_t nodes_per_search = 0;
+        int move_r = -1, move_c = -1, depth = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto now = start;
+        do {
+            RenjuAINegamax::sharedTranspositionTable()->clear();
+            ctx->resetCounters();
+            RenjuAINegamax::heuristicNegamax(ctx, position.gs.data(), corpus->player, corpus->search_depth, true,
+                                             &depth, &move_r, &move_c);
+            nodes_per_search = ctx->node_count;
+            nodes += static_cast<long long>(ctx->node_count);
+            searches++;
+            now = std::chrono::steady_clock::now();
+        } while (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() < min_time_ms);
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+
+        nlohmann::json result;
+        result["name"] = "heuristicNegamax";
+        result["position"] = corpus->name;
+        result["depth"] = depth;
+        result["move_r"] = move_r;
+        result["move_c"] = move_c;
+        result["node_count"] = nodes_per_search;
+        result["searches"] = searches;
+        result["ms_per_search"] = ns / searches / 1e6;
+        result["ns_per_node"] = ns / nodes;
+        result["nodes_per_sec"] = nodes / ns * 1e9;
+        output->push_back(result);
+    }
+}
+
+int main(int argc, char const *argv[]) {
+    long long min_time_ms = 500;
+    const char *filter = "";
+    for (int i = 1; i < argc - 1; i++) {
+        if (strncmp(argv[i], "-t", 2) == 0) min_time_ms = atoll(argv[i + 1]);
+        if (strncmp(argv[i], "-f", 2) == 0) filter = argv[i + 1];
+    }
+
+    // Decode the corpus
+    std::vector<BenchPosition> positions(kRenjuCorpusSize);
+    for (int i = 0; i < kRenjuCorpusSize; ++i) {
+        const RenjuCorpusPosition &corpus = kRenjuCorpus[i];
+        BenchPosition &position = positions[i];
+        position.corpus = &corpus;
+        position.gs.resize(corpus.board_size * corpus.board_size);
+        if (!RenjuAPI::parseGameState(corpus.state, corpus.state_format, corpus.board_size, position.gs.data())) {
+            std::cerr << "Invalid corpus position: " << corpus.name << std::endl;
+            return 1;
+        }
+        position.ctx.reset(new RenjuAISearchContext(corpus.board_size));
+        position.ctx->board.load(position.gs.data());
+
+        RenjuAIEval::DirectionMeasurement adm[4];
+        for (int r = 0; r < corpus.board_size; ++r) {
+            for (int c = 0; c < corpus.board_size; ++c) {
+                if (position.gs[corpus.board_size * r + c] != 0) continue;
+                RenjuAIEval::measureAllDirections(position.ctx.get(), position.gs.data(), r, c, 1, false, adm);
+                position.adms.insert(position.adms.end(), adm, adm + 4);
+            }
+        }
+    }
+
+    static const struct {
+        const char *name;
+        BenchPass pass;
+    } benchmarks[] = {
+        {"evalMove", evalMovePass},
+        {"measureDirection", measureDirectionPass},
+        {"matchPattern", matchPatternPass},
+        {"searchMovesOrdered", searchMovesOrderedPass},
+    };
+
+    nlohmann::json output;
+    output["build"] = std::string(__DATE__) + " " + __TIME__;
+    output["min_time_ms"] = min_time_ms;
+    output["benchmarks"] = nlohmann::json::array();
+    for (const auto &benchmark : benchmarks) {
+        if (strstr(benchmark.name, filter) == nullptr) continue;
+        runBenchmark(benchmark.name, benchmark.pass, &positions, min_time_ms, &output["benchmarks"]);
+    }
+    if (strstr("heuristicNegamax", filter) != nullptr) runSearchBenchmark(&positions, min_time_ms, &output["benchmarks"]);
+
+#ifdef BLUPIG_STATS
+    // Instrumentation totals over all benchmarks
+    output["stats"] = RenjuStats::toJson();
+#endif
+
+    std::cout << output.dump(2) << std::endl;
+    return 0;
+}
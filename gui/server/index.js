@@ -18,16 +18,57 @@
 
 var express = require('express');
 var cors = require('cors');
-var exec = require('child_process').exec;
+var spawn = require('child_process').spawn;
+var readline = require('readline');
+
+// One long-running engine daemon answers all requests, it speaks
+// line-delimited JSON on stdin/stdout and runs a worker per core
+var engine = null;
+var pending = {};
+var nextId = 0;
 
 console.log('Start listening...');
 start();
 
+function startEngine() {
+  engine = spawn('gomoku', ['daemon'], { stdio: ['pipe', 'pipe', 'inherit'] });
+  engine.stdin.on('error', function () {});
+
+  // Responses arrive in completion order, matched to requests by id
+  readline.createInterface({ input: engine.stdout }).on('line', function (line) {
+    var response;
+    try {
+      response = JSON.parse(line);
+    } catch (e) {
+      return;
+    }
+    var res = pending[response.id];
+    if (typeof res === 'undefined') return;
+    delete pending[response.id];
+
+    delete response.id;
+    res.write(JSON.stringify(response));
+    res.end();
+  });
+
+  // Fail the requests in flight and start a new daemon
+  engine.on('exit', function () {
+    for (var id in pending) {
+      pending[id].write(JSON.stringify({ message: 'Engine exited.', result: null }));
+      pending[id].end();
+    }
+    pending = {};
+    setTimeout(startEngine, 1000);
+  });
+}
+
 function start() {
   const corsOptions = {
     origin: 'https://apps.yunzhu.li',
   }
 
+  startEngine();
+
   var app = express();
   app.use(cors());
 
@@ -39,19 +80,18 @@ function start() {
   app.get('/move', function (req, res) {
     // Get query parameters
     var state = req.query.s;
+    var format = req.query.f;
     var player = req.query.p;
 
-    // Build command
-    var cmd = 'gomoku';
-    if (typeof state !== 'undefined' && state.length > 0) cmd += ' -s ' + state;
-    if (typeof player !== 'undefined' && player.length > 0) cmd += ' -p ' + player;
-
-    // Execute command
-    exec(cmd, function(error, stdout, stderr) {
-      // Write response
-      res.write(stdout);
-      res.end();
-    });
+    // Build request
+    var request = { id: nextId++ };
+    if (typeof state !== 'undefined' && state.length > 0) request.s = state;
+    if (typeof format !== 'undefined' && format.length > 0) request.f = format;
+    if (typeof player !== 'undefined' && player.length > 0) request.p = parseInt(player, 10);
+
+    // Send to the engine daemon
+    pending[request.id] = res;
+    engine.stdin.write(JSON.stringify(request) + '\n');
   });
   app.listen(8001);
 }
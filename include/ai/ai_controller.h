@@ -19,14 +19,33 @@
 #ifndef INCLUDE_AI_AI_CONTROLLER_H_
 #define INCLUDE_AI_AI_CONTROLLER_H_
 
+#include <ai/search_context.h>
+
 class RenjuAIController {
  public:
     RenjuAIController();
     ~RenjuAIController();
 
-    static void generateMove(const char *gs, int player, int search_depth, int time_limit,
-                             int *actual_depth, int *move_r, int *move_c, int *winning_player,
-                             unsigned int *node_count, unsigned int *eval_count, unsigned int *pm_count);
+    static void generateMove(RenjuAISearchContext *ctx, const char *gs, int player, int search_depth,
+                             int num_threads, int *actual_depth, int *move_r, int *move_c, int *winning_player);
+
+    // 在ctx->board的当前局面上产生下一步，不下这一步，搜索结束后棋盘不变
+    static void generateMove(RenjuAISearchContext *ctx, int player, int search_depth,
+                             int num_threads, int *actual_depth, int *move_r, int *move_c, int *winning_player);
+
+    // 在对方思考时搜索：预测对方的应对，在应对后的局面上为player迭代加深搜索，直到ctx->stop被设置
+    // 或达到最大深度。预测的应对通过predicted_r、predicted_c回传，没有可以预测的应对时为-1；
+    // 结果写入置换表，下一步搜索时可以直接用上
+    static void ponder(RenjuAISearchContext *ctx, const char *gs, int player, int num_threads,
+                       int *predicted_r, int *predicted_c, int *actual_depth, int *move_r, int *move_c);
+
+    // 在ctx->board的当前局面上思考，结束后棋盘不变
+    // predicted_r、predicted_c传入时可以是对方应对的提示（例如上一步的主要变例），为-1时自己预测
+    static void ponder(RenjuAISearchContext *ctx, int player, int num_threads,
+                       int *predicted_r, int *predicted_c, int *actual_depth, int *move_r, int *move_c);
+
+    // 设置置换表大小（MB），有搜索正在使用置换表时返回false
+    static bool setTranspositionTableSize(int size_mb);
 };
 
 #endif  // INCLUDE_AI_AI_CONTROLLER_H_
@@ -0,0 +1,214 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_AI_BOARD_H_
+#define INCLUDE_AI_BOARD_H_
+
+#include <ai/utils.h>
+#include <utils/stats.h>
+#include <cstdint>
+#include <vector>
+
+// 位棋盘中每条线前后留出的空位，使落子点两侧各5格的窗口总能用移位取出
+#define kRenjuAiBoardLinePadding 5
+
+// 每个方向上线的最大数量（对角线为2 * 边长 - 1条）
+#define kRenjuAiBoardMaxLines (2 * kRenjuAiMaxBoardSize - 1)
+
+struct RenjuAISearchContext;
+
+// 搜索时使用的棋盘：保存游戏状态及其Zobrist哈希值，
+// 并缓存每个空格对双方的启发值（RenjuAIEval::evalMove）
+// 除了char数组，棋盘还按横、右下、竖、左下四个方向为双方各维护一组位棋盘，
+// 连五、“远离”棋子和局势窗口都通过移位和位与得到
+// 下一个棋子只会改变它所在的四条线上的格子的启发值，所以make/unmake只让这四条线上的缓存失效，
+// 失效前的缓存保存在栈中，unmake时原样恢复，回到上一层后不需要重新评估
+class RenjuAIBoard {
+ public:
+    explicit RenjuAIBoard(int board_size = 15);
+
+    // 从行优先存储的游戏状态载入棋盘，清空缓存
+    void load(const char *gs);
+
+    // 在空格(r, c)下player的棋子
+    void make(int r, int c, int player);
+
+    // 撤销最近一次在(r, c)下的棋子
+    void unmake(int r, int c);
+
+    // 对局中下一个棋子或拿走一个棋子：与make/unmake一样增量更新，但失效的缓存不压栈，
+    // 所以不必按后进先出的顺序撤销。只能在不搜索时调用
+    void place(int r, int c, int player);
+    void remove(int r, int c);
+
+    // 某个格子的状态，0为空，出界时返回-1
+    inline char cell(int r, int c) const {
+        return RenjuAIUtils::getCell(gs, board_size, r, c);
+    }
+
+    // 行优先存储的游戏状态
+    inline const char *data() const { return gs; }
+
+    // 棋盘上的棋子数
+    inline int stoneCount() const { return stone_count; }
+
+    // 第r行的候选位置：周围两格内有棋子的空格，第c位表示(r, c)
+    inline uint32_t candidateRow(int r) const { return candidate_rows[r]; }
+
+    // (r, c)周围两格内是否没有任何棋子
+    inline bool remote(int r, int c) const {
+        uint32_t mask = 31u << (c - 2 + kRenjuAiBoardLinePadding);
+        int r_end = r + 2 < board_size - 1 ? r + 2 : board_size - 1;
+        for (int i = r - 2 > 0 ? r - 2 : 0; i <= r_end; ++i) {
+            if ((lines[0][0][i] | lines[1][0][i]) & mask) return false;
+        }
+        return true;
+    }
+
+    // player是否有连成五个（或更多）的棋子
+    bool hasFive(int player) const;
+
+    // 在(r, c)放上player的棋子后（或者已经放上），经过(r, c)的四条线上是否连成五个
+    // 只检查这四条线，用于判断最后一步是否获胜
+    inline bool fiveAt(int r, int c, int player) const {
+        for (int direction = 0; direction < 4; ++direction) {
+            int line = lineIndex(direction, r, c), pos = linePos(direction, r, c);
+            uint32_t w = lines[player - 1][direction][line] | 1u << (pos + kRenjuAiBoardLinePadding);
+
+            // 连续5个的起点在pos - 4至pos之间才经过(r, c)
+            uint32_t runs = w & (w >> 1) & (w >> 2) & (w >> 3) & (w >> 4);
+            if (runs & (31u << (pos + kRenjuAiBoardLinePadding - 4))) return true;
+        }
+        return false;
+    }
+
+    // 获胜的棋手，没有时返回0
+    inline int winningPlayer() const {
+        if (hasFive(1)) return 1;
+        if (hasFive(2)) return 2;
+        return 0;
+    }
+
+    // (r, c)在direction方向上两侧各5格中player的棋子和阻挡（对方的棋子或棋盘外）的位图，
+    // 正方向的格子由近到远占低5位，反方向的格子由近到远占高5位，与RenjuAIEval的局势表编码一致
+    // 方向0至3依次为横、右下、竖、左下
+    inline void lineWindow(int direction, int r, int c, int player, int *own, int *blocked) const {
+        int line = lineIndex(direction, r, c), pos = linePos(direction, r, c);
+        uint32_t mine  = lines[player - 1][direction][line];
+        uint32_t other = lines[2 - player][direction][line] | ~line_masks[direction][line];
+        *own     = ((mine  >> (pos + kRenjuAiBoardLinePadding + 1)) & 31) | reversed_bits[(mine  >> pos) & 31] << 5;
+        *blocked = ((other >> (pos + kRenjuAiBoardLinePadding + 1)) & 31) | reversed_bits[(other >> pos) & 31] << 5;
+    }
+
+    // 棋盘的Zobrist哈希值
+    inline uint64_t hash() const { return zobrist_hash; }
+
+    // 在空格(r, c)放上player的棋子后棋盘的哈希值
+    inline uint64_t hashAfter(int r, int c, int player) const {
+        return zobrist_hash ^ zobrist_keys[player - 1][kRenjuAiMaxBoardSize * r + c];
+    }
+
+    // 轮到player下棋的局面的哈希值，同一棋盘轮到不同的人下棋是不同的局面
+    inline uint64_t key(int player) const {
+        return player == 2 ? zobrist_hash ^ zobrist_keys[0][kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize]
+                           : zobrist_hash;
+    }
+
+    // 空格(r, c)对player的启发值，没有缓存时调用RenjuAIEval::evalMove并缓存
+    inline int heuristic(RenjuAISearchContext *ctx, int r, int c, int player) {
+        int &score = heuristic_cache[player - 1][board_size * r + c];
+        if (score == kInvalidHeuristic) {
+            BLUPIG_STATS_COUNT(kRenjuStatsHeuristicCacheMiss);
+            score = evalMove(ctx, r, c, player);
+        } else {
+            BLUPIG_STATS_COUNT(kRenjuStatsHeuristicCacheHit);
+        }
+        return score;
+    }
+
+    int board_size;
+
+ private:
+    // 缓存中表示需要重新评估的值
+    static const int kInvalidHeuristic = -1;
+
+    // unmake时恢复的一格缓存
+    struct SavedHeuristic {
+        int index;
+        int score[2];
+    };
+
+    // 让经过(r, c)的四条线上的缓存失效，save为true时失效前的值压栈
+    void invalidateLines(int r, int c, bool save);
+
+    int evalMove(RenjuAISearchContext *ctx, int r, int c, int player);
+
+    // 格子(r, c)在某个方向上所在的线，及其在线上的位置
+    // 右下方向的线按r - c编号，左下方向的线按r + c编号，斜线上的位置都是行号
+    inline int lineIndex(int direction, int r, int c) const {
+        switch (direction) {
+            case 0:  return r;
+            case 1:  return r - c + board_size - 1;
+            case 2:  return c;
+            default: return r + c;
+        }
+    }
+    static inline int linePos(int direction, int r, int c) {
+        return direction == 0 ? c : r;
+    }
+
+    // 在位棋盘中放上或拿走一个棋子
+    void toggleBits(int r, int c, int player);
+
+    // 放上（delta为1）或拿走（delta为-1）(r, c)的棋子时，更新周围两格的邻近棋子数和候选位置
+    void updateCandidates(int r, int c, int delta);
+
+    char gs[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize];
+    uint64_t zobrist_hash;
+    int stone_count;
+
+    // 位棋盘：lines[player - 1][direction][line]的第(pos + kRenjuAiBoardLinePadding)位
+    // 表示这条线上位置pos有player的棋子
+    uint32_t lines[2][4][kRenjuAiBoardMaxLines];
+
+    // 每条线上位于棋盘内的位置
+    uint32_t line_masks[4][kRenjuAiBoardMaxLines];
+
+    // 每格周围两格（5x5范围，包括自身）内的棋子数，以及由此得到的每行候选位置
+    unsigned char neighbor_counts[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize];
+    uint32_t candidate_rows[kRenjuAiMaxBoardSize];
+
+    // 5位二进制数按位反转，用于把反方向的格子排成由近到远
+    static const unsigned char reversed_bits[32];
+
+    // 每格对双方的启发值缓存
+    int heuristic_cache[2][kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize];
+
+    // 被make改写的缓存，每次make压入的数量记录在saved_counts中
+    std::vector<SavedHeuristic> saved_heuristics;
+    std::vector<int> saved_counts;
+
+    // Zobrist哈希使用的随机数，各格按最大棋盘尺寸的行宽编号，不同尺寸的棋盘上同一格使用同一个随机数；
+    // 之后zobrist_keys[0]的一项用于区分下棋方，zobrist_keys[1]的各项按棋盘尺寸区分不同尺寸的棋盘，
+    // 进程共享的置换表中不同尺寸棋盘的局面因此不会混淆
+    static uint64_t zobrist_keys[2][kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize + kRenjuAiMaxBoardSize + 1];
+    static bool zobrist_initialized;
+    static bool initZobristKeys();
+};
+
+#endif  // INCLUDE_AI_BOARD_H_
@@ -0,0 +1,86 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_AI_ENGINE_H_
+#define INCLUDE_AI_ENGINE_H_
+
+#include <ai/search_context.h>
+#include <ai/transposition_table.h>
+#include <atomic>
+#include <vector>
+
+// 一局（或多局）对弈中持续存在的引擎
+// 保存棋盘及其增量维护的启发值缓存、自己的置换表和上一次搜索的主要变例，
+// 对局中的每一步只增量地修改棋盘，下一次搜索可以直接用上之前的结果
+// 不是线程安全的：思考（ponder）时不能调用其他方法
+class RenjuAIEngine {
+ public:
+    explicit RenjuAIEngine(int board_size = 15);
+
+    // 开始新的一局，清空棋盘。棋盘尺寸不变时保留置换表
+    void reset(int board_size);
+
+    // 设置置换表大小（MB），为0时禁用置换表
+    void setTranspositionTableSize(int size_mb);
+
+    // 在空格(r, c)下player的棋子，位置不合法时返回false
+    bool play(int r, int c, int player);
+
+    // 拿走(r, c)的棋子，没有棋子时返回false
+    bool remove(int r, int c);
+
+    // 把棋盘设为行优先存储的游戏状态gs，只在不同的格子上下棋或拿走棋子
+    void setPosition(const char *gs);
+
+    // 为player产生下一步（不下这一步），参数同RenjuAIController::generateMove
+    // stop被设置时搜索提前结束，使用已经完成的迭代的结果，可以为nullptr
+    void generateMove(int player, int search_depth, int time_limit, int num_threads,
+                      int *actual_depth, int *move_r, int *move_c, int *winning_player,
+                      const std::atomic<bool> *stop = nullptr);
+
+    // 设置之后的搜索每完成一次迭代时调用的回调，callback为nullptr时取消
+    void setIterationCallback(RenjuAIIterationCallback callback, void *data);
+
+    // 在对方思考时为player思考，直到stop被设置，参数同RenjuAIController::ponder
+    // 以上一次搜索的主要变例中对方的应对作为预测
+    void ponder(int player, int num_threads, const std::atomic<bool> *stop,
+                int *predicted_r, int *predicted_c, int *actual_depth, int *move_r, int *move_c);
+
+    // 局面对player的静态评估：所有空格对双方启发值之和的差，用于交换（swap2）时选择执子颜色
+    int evaluate(int player);
+
+    inline int boardSize() const { return ctx.board_size; }
+    inline const RenjuAIBoard &board() const { return ctx.board; }
+
+    // 最近一次搜索或思考的上下文，包含计数器
+    inline const RenjuAISearchContext &context() const { return ctx; }
+
+    // 上一次generateMove的主要变例，第0项是产生的下法，第1项是预测的对方应对
+    inline const std::vector<RenjuAIMove> &principalVariation() const { return pv; }
+
+ private:
+    // 第一次搜索时才分配置换表
+    void allocateTranspositionTable();
+
+    RenjuAISearchContext ctx;
+    RenjuAITranspositionTable transposition_table;
+    int transposition_table_size;
+    std::vector<RenjuAIMove> pv;
+};
+
+#endif  // INCLUDE_AI_ENGINE_H_
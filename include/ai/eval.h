@@ -22,19 +22,33 @@
 #define kRenjuAiEvalWinningScore 10000
 #define kRenjuAiEvalThreateningScore 300
 
+// 查表测量局势时，落子点每侧查看的格子数，以及窗口编码后的表项数（3^10）
+#define kRenjuAiEvalLineWindow 5
+#define kRenjuAiEvalLineTableSize 59049
+
+// 棋谱数量；局势按得分分成的类别数，以及四个方向类别组合的数量（C(13, 4)）
+#define kRenjuAiEvalPresetPatternsSize 11
+#define kRenjuAiEvalMeasurementClasses 10
+#define kRenjuAiEvalADMTableSize 715
+
+#include <ai/search_context.h>
+#include <climits>
+#include <cstdint>
+
 class RenjuAIEval {
  public:
     RenjuAIEval();
     ~RenjuAIEval();
 
     // 评估这个游戏状态的得分
-    static int evalState(const char *gs, int player);
+    static int evalState(RenjuAISearchContext *ctx, const char *gs, int player);
 
     // 评估某个下法的得分
-    static int evalMove(const char *gs, int r, int c, int player);
+    static int evalMove(RenjuAISearchContext *ctx, const char *gs, int r, int c, int player);
+    static int evalMove(RenjuAISearchContext *ctx, const RenjuAIBoard &board, int r, int c, int player);
 
     // 检查是否有棋手获胜
-    static int winningPlayer(const char *gs);
+    static int winningPlayer(RenjuAISearchContext *ctx, const char *gs);
 
 // Allow testing private members in this class
 #ifndef BLUPIG_TEST
@@ -55,35 +69,195 @@ class RenjuAIEval {
         char space_count;     // 这个方向的“局势”可以空出的棋子的数量，也就是允许不连续的下棋
     };
 
-    // 用来存储生成的棋谱
-    static DirectionPattern *preset_patterns;
+    // 棋谱，每个棋谱由两个方向的局势组成，第二个长度为0时只有一个
+    // block_count或space_count为-1时不要求匹配
+    static constexpr DirectionPattern preset_patterns[kRenjuAiEvalPresetPatternsSize * 2] = {
+        {1, 5,  0,  0}, {0, 0,  0,  0},  // 10000
+        {1, 4,  0,  0}, {0, 0,  0,  0},  // 700
+        {2, 4,  1,  0}, {0, 0,  0,  0},  // 700
+        {2, 4, -1,  1}, {0, 0,  0,  0},  // 700
+        {1, 4,  1,  0}, {1, 4, -1,  1},  // 700
+        {1, 4,  1,  0}, {1, 3,  0, -1},  // 500
+        {1, 4, -1,  1}, {1, 3,  0, -1},  // 500
+        {2, 3,  0, -1}, {0, 0,  0,  0},  // 300
+        {3, 2,  0, -1}, {0, 0,  0,  0},  // 50
+        {1, 3,  0, -1}, {0, 0,  0,  0},  // 20
+        {1, 2,  0, -1}, {0, 0,  0,  0}   // 9
+    };
 
-    // 用于保存每个棋谱的得分
-    static int *preset_scores;
+    // 每个棋谱的得分
+    static constexpr int preset_scores[kRenjuAiEvalPresetPatternsSize] = {
+        10000, 700, 700, 700, 700, 500, 500, 300, 50, 20, 9
+    };
 
-    // 在内存中生成棋谱
-    static void generatePresetPatterns(DirectionPattern **preset_patterns,
-                                       int **preset_scores,
-                                       int *preset_patterns_size,
-                                       int *preset_patterns_skip);
+    // 四个方向最长的局势长度为i时，前面的棋谱不可能匹配，从第preset_patterns_skip[i]个棋谱开始匹配
+    static constexpr int preset_patterns_skip[6] = {
+        kRenjuAiEvalPresetPatternsSize, kRenjuAiEvalPresetPatternsSize, 10, 7, 1, 0
+    };
 
-    // 评估四个方向的局势得分
-    static int evalADM(DirectionMeasurement *all_direction_measurement);
+    // 局势的类别：同一类的局势长度相同，匹配的棋谱也相同，所以得分只取决于四个方向的类别组合
+    // 下标为(length - 1) * 6 + block_count * 2 + space_count
+    static constexpr char measurement_classes[30] = {
+        0, 0, 0, 0, 0, 0,  // 长度1
+        1, 1, 2, 2, 2, 2,  // 长度2，两端都没被堵 / 被堵
+        3, 3, 4, 4, 4, 4,  // 长度3，两端都没被堵 / 被堵
+        5, 7, 6, 7, 8, 7,  // 长度4，不允许空格时按被堵数量分类，允许空格的是一类
+        9, 9, 9, 9, 9, 9   // 长度5
+    };
+
+    // 每个类别的一个局势，用来计算得分表
+    static constexpr DirectionMeasurement measurement_class_representatives[kRenjuAiEvalMeasurementClasses] = {
+        {1, 0, 0}, {2, 0, 0}, {2, 1, 0}, {3, 0, 0}, {3, 1, 0},
+        {4, 0, 0}, {4, 1, 0}, {4, 1, 1}, {4, 2, 0}, {5, 0, 0}
+    };
+
+    // 四个方向类别组合的得分表，在编译期生成
+    struct ADMScoreTable {
+        int scores[kRenjuAiEvalADMTableSize];
+    };
+    static const ADMScoreTable adm_score_table;
+
+    // 评估四个方向的局势得分，查得分表
+    static int evalADM(RenjuAISearchContext *ctx, DirectionMeasurement *all_direction_measurement);
 
     // 尝试匹配某个方向的局势和棋谱
-    static int matchPattern(DirectionMeasurement *all_direction_measurement,
-                            DirectionPattern *patterns);
+    static int matchPattern(RenjuAISearchContext *ctx,
+                            DirectionMeasurement *all_direction_measurement,
+                            const DirectionPattern *patterns);
+
+    // 统计四个方向的局势与某个棋谱的匹配次数
+    static constexpr int countPatternMatches(const DirectionMeasurement *all_direction_measurement,
+                                             const DirectionPattern *patterns) {
+        int match_count = INT_MAX;
+
+        // 每个方向的局势只查找两个棋谱
+        for (int i = 0; i < 2; ++i) {
+            const DirectionPattern &p = patterns[i];
+            if (p.length == 0) break;
+
+            // 查找4个方向的局势
+            // 如果棋谱和局势完全匹配，匹配的数量增加，注意有的棋谱不要求block和space
+            int single_pattern_match = 0;
+            for (int j = 0; j < 4; ++j) {
+                const DirectionMeasurement &dm = all_direction_measurement[j];
+                if (dm.length == p.length &&
+                    (p.block_count == -1 || dm.block_count == p.block_count) &&
+                    (p.space_count == -1 || dm.space_count == p.space_count)) {
+                    single_pattern_match++;
+                }
+            }
+
+            // Consider minimum number of occurrences
+            single_pattern_match /= p.min_occurrence;
+
+            // 取匹配到的局势数量最少的棋谱的匹配次数
+            match_count = match_count >= single_pattern_match ? single_pattern_match : match_count;
+        }
+        return match_count;
+    }
+
+    // 逐个匹配棋谱计算四个方向局势的得分，用来生成得分表
+    static constexpr int scoreADM(const DirectionMeasurement *all_direction_measurement) {
+        // 每个方向棋子越长，分数越高，因为五子棋越长越好
+        // “棋谱”内的下法有的长度超过了当前方向连续棋子的长度，因此把这些棋谱忽略掉
+        int score = 0;
+        int max_measured_len = 0;
+        for (int i = 0; i < 4; i++) {
+            int len = all_direction_measurement[i].length;
+            max_measured_len = len > max_measured_len ? len : max_measured_len;
+            score += len - 1;
+        }
+
+        // 将所有方向的“局势”与“棋谱”进行匹配，如果匹配到“棋谱”，按照棋谱的分数给分
+        for (int i = preset_patterns_skip[max_measured_len]; i < kRenjuAiEvalPresetPatternsSize; ++i) {
+            score += countPatternMatches(all_direction_measurement, &preset_patterns[2 * i]) * preset_scores[i];
+
+            // 如果匹配到了“绝招”棋谱，直接退出
+            if (score >= kRenjuAiEvalThreateningScore) break;
+        }
+        return score;
+    }
+
+    // 从小到大排列的四个类别组合在得分表中的序号
+    static constexpr int rankClasses(int a, int b, int c, int d) {
+        return a + (b + 1) * b / 2 + (c + 2) * (c + 1) * c / 6 + (d + 3) * (d + 2) * (d + 1) * d / 24;
+    }
+
+    // 生成得分表
+    static constexpr ADMScoreTable buildADMScoreTable() {
+        ADMScoreTable table{};
+        for (int a = 0; a < kRenjuAiEvalMeasurementClasses; ++a)
+            for (int b = a; b < kRenjuAiEvalMeasurementClasses; ++b)
+                for (int c = b; c < kRenjuAiEvalMeasurementClasses; ++c)
+                    for (int d = c; d < kRenjuAiEvalMeasurementClasses; ++d) {
+                        DirectionMeasurement adm[4] = {
+                            measurement_class_representatives[a], measurement_class_representatives[b],
+                            measurement_class_representatives[c], measurement_class_representatives[d]
+                        };
+                        table.scores[rankClasses(a, b, c, d)] = scoreADM(adm);
+                    }
+        return table;
+    }
 
     // 测量四个方向的局势
-    static void measureAllDirections(const char *gs,
+    static void measureAllDirections(RenjuAISearchContext *ctx,
+                                     const char *gs,
                                      int r,
                                      int c,
                                      int player,
                                      bool consecutive,
                                      RenjuAIEval::DirectionMeasurement *adm);
 
+    // 查表测量四个方向的局势，同时得到不连续和连续两种测量结果
+    // 结果与measureAllDirections完全一致
+    static void lookupAllDirections(RenjuAISearchContext *ctx,
+                                    const char *gs,
+                                    int r,
+                                    int c,
+                                    int player,
+                                    RenjuAIEval::DirectionMeasurement *adm,
+                                    RenjuAIEval::DirectionMeasurement *adm_consecutive);
+    static void lookupAllDirections(RenjuAISearchContext *ctx,
+                                    const RenjuAIBoard &board,
+                                    int r,
+                                    int c,
+                                    int player,
+                                    RenjuAIEval::DirectionMeasurement *adm,
+                                    RenjuAIEval::DirectionMeasurement *adm_consecutive);
+
+    // 按一个方向窗口的位图查局势表，得到不连续和连续的测量结果
+    static void decodeLineEntry(RenjuAISearchContext *ctx,
+                                const char *gs,
+                                int r, int c,
+                                int direction,
+                                int player,
+                                int own, int blocked,
+                                RenjuAIEval::DirectionMeasurement *dm,
+                                RenjuAIEval::DirectionMeasurement *dm_consecutive);
+
+    // 查表测量局势的四个方向
+    static constexpr int line_directions[4][2] = {{0, 1}, {1, 1}, {1, 0}, {1, -1}};
+
+    // 局势表：以落子点两侧窗口的编码为下标，每格编码为0（空）、1（己方）、2（对方或边界），
+    // 离落子点近的格子在低位，正方向占低5位，反方向占高5位
+    // 每项低6位是不连续的测量结果，接着6位是连续的测量结果，
+    // 第12、13位表示对应的测量需要窗口以外的格子，这时退回到measureDirection
+    static uint16_t line_table[kRenjuAiEvalLineTableSize];
+
+    // 10位二进制数按位转换成三进制数，用于把己方、阻挡两个位图合成窗口编码
+    static uint16_t line_table_base3[1 << (2 * kRenjuAiEvalLineWindow)];
+
+    // 生成局势表，在静态初始化时调用
+    static bool line_table_initialized;
+    static bool initLineTable();
+
+    // 在窗口内测量局势，window为2 * kRenjuAiEvalLineWindow + 1格，中心是落子点
+    // 需要窗口以外的格子才能确定结果时返回false
+    static bool measureWindow(const char *window, bool consecutive, RenjuAIEval::DirectionMeasurement *result);
+
     // 测量单个方向的局势
-    static void measureDirection(const char *gs,
+    static void measureDirection(RenjuAISearchContext *ctx,
+                                 const char *gs,
                                  int r, int c,
                                  int dr, int dc,
                                  int player,
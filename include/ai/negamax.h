@@ -19,6 +19,10 @@
 #ifndef INCLUDE_AI_NEGAMAX_H_
 #define INCLUDE_AI_NEGAMAX_H_
 
+#include <ai/search_context.h>
+#include <ai/transposition_table.h>
+#include <ai/utils.h>
+#include <mutex>
 #include <vector>
 
 class RenjuAINegamax {
@@ -26,35 +30,87 @@ class RenjuAINegamax {
     RenjuAINegamax();
     ~RenjuAINegamax();
 
-    static void heuristicNegamax(const char *gs, int player, int depth, int time_limit, bool enable_ab_pruning,
-                                 int *actual_depth, int *move_r, int *move_c);
+    static void heuristicNegamax(RenjuAISearchContext *ctx, const char *gs, int player, int depth,
+                                 bool enable_ab_pruning, int *actual_depth, int *move_r, int *move_c,
+                                 int num_threads = 1);
 
+    // 在ctx->board的当前局面上搜索，不重新载入棋盘，棋盘上的启发值缓存可以跨多次搜索保留
+    static void search(RenjuAISearchContext *ctx, int player, int depth, bool enable_ab_pruning,
+                       int *actual_depth, int *move_r, int *move_c, int num_threads = 1);
+
+    // 设置进程共享的置换表大小（MB），为0时禁用置换表
+    // 有搜索正在使用它时不改变大小，返回false
+    static bool setTranspositionTableSize(int size_mb);
+
+    // 进程共享的置换表，没有指定置换表的搜索使用它
+    static RenjuAITranspositionTable *sharedTranspositionTable();
+
+    // 在作用域内登记ctx对进程共享置换表的使用（ctx没有指定置换表或指定的就是它时；ctx为nullptr时总是登记），
+    // 期间setTranspositionTableSize会被拒绝，避免搜索访问已释放的表
+    class SharedTableUse {
+     public:
+        explicit SharedTableUse(const RenjuAISearchContext *ctx = nullptr);
+        ~SharedTableUse();
+
+        SharedTableUse(const SharedTableUse &) = delete;
+        SharedTableUse &operator=(const SharedTableUse &) = delete;
+
+     private:
+        bool registered;
+    };
+
+    // 从ctx->board的当前局面，player下(move_r, move_c)开始，沿置换表中保存的最佳下法取出主要变例，
+    // 最多max_length步，棋盘会还原
+    static void principalVariation(RenjuAISearchContext *ctx, int player, int move_r, int move_c,
+                                   int max_length, std::vector<RenjuAIMove> *pv);
+
+// Allow testing private members in this class
+#ifndef BLUPIG_TEST
  private:
+#endif
     // 每层的搜索宽度
     static int presetSearchBreadth[5];
 
-    // 一个候选下法
-    struct Move {
-        int r;
-        int c;
-        int heuristic_val;
-        int actual_score;
+    // 进程共享的置换表及其大小（MB），以及正在使用它的搜索数
+    static RenjuAITranspositionTable transposition_table;
+    static int transposition_table_size;
+    static int transposition_table_users;
+    static std::mutex transposition_table_mutex;
 
-        // 重载<运算符用于给“下法”类排序
-        bool operator<(Move other) const {
-            return heuristic_val > other.heuristic_val;
+    static int heuristicNegamax(RenjuAISearchContext *ctx, int player, int initial_depth, int depth,
+                                bool enable_ab_pruning, int alpha, int beta,
+                                int *move_r, int *move_c);
+
+    // 一次迭代开始时的计数器，用来算出这次迭代的统计
+    struct IterationCounters {
+        uint64_t node_count;
+        uint64_t expanded_count;
+        uint64_t cutoff_count;
+        uint64_t first_move_cutoff_count;
+        uint64_t tt_probe_count;
+        uint64_t tt_hit_count;
+
+        static IterationCounters of(const RenjuAISearchContext *ctx) {
+            return {ctx->node_count, ctx->expanded_count, ctx->cutoff_count,
+                    ctx->first_move_cutoff_count, ctx->tt_probe_count, ctx->tt_hit_count};
         }
     };
 
-    static int heuristicNegamax(char *gs, int player, int initial_depth, int depth,
-                                bool enable_ab_pruning, int alpha, int beta,
-                                int *move_r, int *move_c);
+    // 把完成的一次迭代的统计加到ctx->iterations
+    static void recordIteration(RenjuAISearchContext *ctx, const IterationCounters &start, int player,
+                                int depth, int score, int move_r, int move_c);
+
+    // Lazy SMP辅助线程：与主线程共享置换表，从错开的深度开始迭代加深，直到ctx->stop被设置
+    static void helperSearch(RenjuAISearchContext *ctx, const char *gs, int player, int depth,
+                             bool enable_ab_pruning, int thread_id);
 
     // 搜索所有可以下的位置，即宽度搜索
-    static void searchMovesOrdered(const char *gs, int player, std::vector<Move> *result);
+    // 只保留启发值最高的limit个下法（limit为-1时保留全部），按启发值从大到小排列，
+    // 启发值相同时行优先靠前的在前；返回可以下的位置的总数
+    static int searchMovesOrdered(RenjuAISearchContext *ctx, int player, RenjuAIMoveList *result, int limit = -1);
 
     // 未使用
-    static int negamax(char *gs, int player, int depth,
+    static int negamax(RenjuAISearchContext *ctx, char *gs, int player, int depth,
                        int *move_r, int *move_c);
 };
 
@@ -0,0 +1,202 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_AI_SEARCH_CONTEXT_H_
+#define INCLUDE_AI_SEARCH_CONTEXT_H_
+
+#include <ai/board.h>
+#include <ai/time_manager.h>
+#include <ai/transposition_table.h>
+#include <ai/utils.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// 最大搜索深度，也是搜索上下文中预先分配的下法列表的层数
+#define kRenjuAiMaxSearchDepth 16
+
+// 一个候选下法
+struct RenjuAIMove {
+    int r;
+    int c;
+    int heuristic_val;
+    int actual_score;
+
+    // 重载<运算符用于给“下法”类排序
+    bool operator<(const RenjuAIMove &other) const {
+        return heuristic_val > other.heuristic_val;
+    }
+};
+
+// 固定容量的下法列表，最多容纳棋盘上所有的格子，使用时不申请内存
+class RenjuAIMoveList {
+ public:
+    RenjuAIMoveList() : count(0) {}
+
+    inline void clear() { count = 0; }
+    inline void push_back(const RenjuAIMove &move) { moves[count++] = move; }
+    inline int size() const { return count; }
+    inline RenjuAIMove &operator[](int i) { return moves[i]; }
+    inline RenjuAIMove *begin() { return moves; }
+    inline RenjuAIMove *end() { return moves + count; }
+
+ private:
+    RenjuAIMove moves[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize];
+    int count;
+};
+
+// 搜索树中一层使用的下法列表
+struct RenjuAISearchPly {
+    RenjuAIMoveList moves_player;     // 己方可走的位置
+    RenjuAIMoveList moves_opponent;   // 对方可走的位置
+    RenjuAIMoveList candidate_moves;  // 本层要深入搜索的下法
+};
+
+// 一次完成的迭代的统计
+struct RenjuAIIterationStats {
+    int depth;                     // 迭代深度
+    long long elapsed;             // 迭代完成时距搜索开始的墙上时间（毫秒）
+    uint64_t node_count;           // 本次迭代的结点数
+    double branching_factor;       // 有效分支因子：node_count ^ (1 / depth)
+    double beta_cutoff_rate;       // 展开的结点中发生beta剪枝的比例
+    double first_move_cutoff_rate; // beta剪枝中由第一个下法引起的比例，衡量搜索顺序
+    double tt_hit_rate;            // 置换表查找的命中率
+    int move_r;                    // 本次迭代得到的下法
+    int move_c;
+    int score;                     // 根结点的分数
+    std::vector<RenjuAIMove> pv;   // 主要变例，第0项是得到的下法
+};
+
+struct RenjuAISearchContext;
+
+// 迭代加深每完成一次迭代后的回调：data是注册时给出的参数，depth是这次迭代的深度，
+// score是根结点的分数，(move_r, move_c)是这次迭代得到的下法
+typedef void (*RenjuAIIterationCallback)(void *data, const RenjuAISearchContext &ctx, int depth, int score,
+                                         int move_r, int move_c);
+
+// 一次搜索的上下文：棋盘尺寸、计数器、时间预算和临时缓冲区
+// 搜索、评估都只读写自己的上下文，所以一个进程可以同时进行多盘互不相关的搜索
+// 每个搜索线程使用自己的上下文，计数器不会被多个线程争用
+struct RenjuAISearchContext {
+    explicit RenjuAISearchContext(int board_size = 15) :
+        board_size(board_size),
+        gs_size(board_size * board_size),
+        time_limit(0),
+        node_limit(0),
+        aborted(false),
+        stop(nullptr),
+        transposition_table(nullptr),
+        iteration_callback(nullptr),
+        iteration_callback_data(nullptr),
+        board(board_size),
+        plies(kRenjuAiMaxSearchDepth) {
+        resetCounters();
+        iterations.reserve(kRenjuAiMaxSearchDepth);
+    }
+
+    void resetCounters() {
+        node_count = 0;
+        eval_count = 0;
+        pm_count = 0;
+        expanded_count = 0;
+        cutoff_count = 0;
+        first_move_cutoff_count = 0;
+        tt_probe_count = 0;
+        tt_hit_count = 0;
+        cpu_time = 0;
+    }
+
+    // 把另一个上下文（辅助线程）的计数器加到本上下文
+    void addCounters(const RenjuAISearchContext &other) {
+        node_count += other.node_count;
+        eval_count += other.eval_count;
+        pm_count += other.pm_count;
+        expanded_count += other.expanded_count;
+        cutoff_count += other.cutoff_count;
+        first_move_cutoff_count += other.first_move_cutoff_count;
+        tt_probe_count += other.tt_probe_count;
+        tt_hit_count += other.tt_hit_count;
+        cpu_time += other.cpu_time;
+    }
+
+    // 每kRenjuAiTimeCheckInterval个结点检查一次硬期限，过了就中止搜索
+    // 有结点数预算时，用完预算也中止搜索
+    inline void pollTime() {
+        if ((node_count & (kRenjuAiTimeCheckInterval - 1)) == 0 && timer.hardDeadlinePassed())
+            aborted = true;
+        if (node_limit != 0 && node_count >= node_limit)
+            aborted = true;
+    }
+
+    // 搜索是否应该立即返回：超时中止，或者停止标志被设置
+    inline bool stopped() const {
+        return aborted || (stop != nullptr && stop->load(std::memory_order_relaxed));
+    }
+
+    // 棋盘尺寸
+    int board_size;
+    int gs_size;
+
+    // 计数器：搜索结点数、评估次数、棋谱匹配（查得分表）次数
+    uint64_t node_count;
+    uint64_t eval_count;
+    uint64_t pm_count;
+
+    // 搜索统计：展开（搜索了候选下法）的结点数、beta剪枝次数、其中第一个下法就剪枝的次数、
+    // 置换表查找次数和命中次数
+    uint64_t expanded_count;
+    uint64_t cutoff_count;
+    uint64_t first_move_cutoff_count;
+    uint64_t tt_probe_count;
+    uint64_t tt_hit_count;
+
+    // 搜索用掉的CPU时间（微秒），包括Lazy SMP辅助线程的
+    uint64_t cpu_time;
+
+    // 迭代加深的时间预算（毫秒）、计时器，以及本次搜索是否因超时被中止
+    int time_limit;
+
+    // 迭代加深的结点数预算，不为0时代替时间预算：是否开始下一次迭代、何时中止都只取决于结点数，
+    // 单线程搜索并且置换表状态相同时，结果与机器快慢无关，可以逐个结点地重现
+    uint64_t node_limit;
+    RenjuAITimeManager timer;
+    bool aborted;
+
+    // 停止标志，设置后搜索立即返回，可以为nullptr
+    const std::atomic<bool> *stop;
+
+    // 使用的置换表，为nullptr时使用进程共享的置换表
+    RenjuAITranspositionTable *transposition_table;
+
+    // 每完成一次迭代（指定深度时是唯一的一次搜索）后调用，可以为nullptr
+    // 只由调用搜索的线程调用，可以在回调中设置停止标志来结束搜索
+    RenjuAIIterationCallback iteration_callback;
+    void *iteration_callback_data;
+
+    // 最近一次搜索中每次完成的迭代的统计，按深度排列
+    std::vector<RenjuAIIterationStats> iterations;
+
+    // 搜索时修改的棋盘
+    RenjuAIBoard board;
+
+    // 每层的下法列表，第i项由距根结点i层的结点使用
+    // 创建上下文时一次分配，搜索时不再申请内存
+    std::vector<RenjuAISearchPly> plies;
+};
+
+#endif  // INCLUDE_AI_SEARCH_CONTEXT_H_
@@ -0,0 +1,65 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_AI_TIME_MANAGER_H_
+#define INCLUDE_AI_TIME_MANAGER_H_
+
+#include <chrono>
+
+// 搜索中每隔多少个结点检查一次时间，必须是2的幂
+#define kRenjuAiTimeCheckInterval 256
+
+// 软期限占时间预算的比例，过了软期限不再开始新的迭代
+#define kRenjuAiTimeSoftRatio 0.5
+
+// 迭代加深时评估分支数，用于预估下一次迭代的时间
+#define kRenjuAiTimeBranchingFactor 3
+
+// 迭代加深的计时器，使用单调的墙上时间
+// 软期限决定是否开始下一次迭代，硬期限到达时正在进行的迭代被中止
+class RenjuAITimeManager {
+ public:
+    RenjuAITimeManager();
+
+    // 以time_limit毫秒的预算开始计时
+    void start(int time_limit);
+
+    // 不限时，硬期限永远不会到达
+    void startUnlimited();
+
+    // 从开始计时到现在的毫秒数
+    long long elapsed() const;
+
+    // 上一次迭代用了last_iteration毫秒，是否还应该开始下一次迭代：
+    // 没有过软期限，并且按分支数预估下一次迭代能在硬期限前完成
+    bool shouldStartIteration(long long last_iteration) const;
+
+    // 是否已经过了硬期限
+    inline bool hardDeadlinePassed() const {
+        return limited && std::chrono::steady_clock::now() >= hard_deadline;
+    }
+
+ private:
+    bool limited;
+    int time_limit;
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point soft_deadline;
+    std::chrono::steady_clock::time_point hard_deadline;
+};
+
+#endif  // INCLUDE_AI_TIME_MANAGER_H_
@@ -0,0 +1,86 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_AI_TRANSPOSITION_TABLE_H_
+#define INCLUDE_AI_TRANSPOSITION_TABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 置换表默认大小（MB）
+#define kRenjuAiTTDefaultSizeMB 16
+
+// 固定大小的置换表，以Zobrist哈希为键，保存搜索过的局面的结果
+// 多个搜索线程可以无锁地共享同一个置换表：每项保存“键异或数据”和数据两个64位字，
+// 读到被其他线程写了一半的项时，键对不上，当作没有找到
+class RenjuAITranspositionTable {
+ public:
+    RenjuAITranspositionTable();
+    ~RenjuAITranspositionTable();
+
+    // 保存的分数是精确值、下界还是上界
+    enum Bound {
+        kBoundNone  = 0,
+        kBoundExact = 1,
+        kBoundLower = 2,
+        kBoundUpper = 3
+    };
+
+    // 表中的一项
+    struct Entry {
+        uint64_t key;   // 局面的哈希值
+        int score;      // 搜索得到的分数
+        char depth;     // 搜索时的剩余深度
+        char initial_depth;  // 所在搜索的初始深度，与剩余深度一起决定了各层的搜索宽度
+        char bound;     // 分数的类型（Bound）
+        char move_r;    // 最佳下法的行
+        char move_c;    // 最佳下法的列
+    };
+
+    // 重新分配置换表，使其不超过size_mb MB，同时清空所有项
+    // size_mb为0时禁用置换表
+    void resize(int size_mb);
+
+    // 清空所有项
+    void clear();
+
+    // 是否已分配
+    bool enabled() const { return entries != nullptr; }
+
+    // 查找某个局面，找到时返回true并通过result回传
+    bool probe(uint64_t key, Entry *result) const;
+
+    // 保存某个局面的搜索结果
+    void store(uint64_t key, int initial_depth, int depth, int bound, int score, int move_r, int move_c);
+
+ private:
+    // 实际存储的一项，共16字节
+    struct Slot {
+        std::atomic<uint64_t> check;  // key ^ data
+        std::atomic<uint64_t> data;   // 打包后的Entry（不含key）
+    };
+
+    Slot *entries;
+    size_t mask;
+
+    static uint64_t pack(int initial_depth, int depth, int bound, int score, int move_r, int move_c);
+    static void unpack(uint64_t data, Entry *result);
+};
+
+#endif  // INCLUDE_AI_TRANSPOSITION_TABLE_H_
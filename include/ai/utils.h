@@ -19,28 +19,32 @@
 #ifndef INCLUDE_AI_UTILS_H_
 #define INCLUDE_AI_UTILS_H_
 
-#include <utils/globals.h>
+#include <cstdint>
+
+// 支持的最大棋盘边长（Gomocup允许15至20）
+#define kRenjuAiMaxBoardSize 20
 
 class RenjuAIUtils {
  public:
     RenjuAIUtils();
     ~RenjuAIUtils();
 
-    static inline char getCell(const char *gs, int r, int c) {
-        if (r < 0 || r >= g_board_size || c < 0 || c >= g_board_size) return -1;
-        return gs[g_board_size * r + c];
+    static inline char getCell(const char *gs, int board_size, int r, int c) {
+        if (r < 0 || r >= board_size || c < 0 || c >= board_size) return -1;
+        return gs[board_size * r + c];
     }
 
-    static inline bool setCell(char *gs, int r, int c, char value) {
-        if (r < 0 || r >= g_board_size || c < 0 || c >= g_board_size) return false;
-        gs[g_board_size * r + c] = value;
+    static inline bool setCell(char *gs, int board_size, int r, int c, char value) {
+        if (r < 0 || r >= board_size || c < 0 || c >= board_size) return false;
+        gs[board_size * r + c] = value;
         return true;
     }
 
-    static bool remoteCell(const char *gs, int r, int c);
+    static bool remoteCell(const char *gs, int board_size, int r, int c);
 
     // Game state hashing
-    static void zobristInit(int size, uint64_t *z1, uint64_t *z2);
+    // Keys are generated from a fixed seed so that searches are reproducible
+    static void zobristInit(int size, uint64_t *z1, uint64_t *z2, uint64_t seed = 0x626c75706967ULL);
     static uint64_t zobristHash(const char *gs, int size, uint64_t *z1, uint64_t *z2);
     static inline void zobristToggle(uint64_t *state, uint64_t *z1, uint64_t *z2,
                                      int row_size, int r, int c, int player) {
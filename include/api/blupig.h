@@ -0,0 +1,105 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef INCLUDE_API_BLUPIG_H_
+#define INCLUDE_API_BLUPIG_H_
+
+/*
+ * C interface of libblupig, for calling the engine in-process from other languages.
+ *
+ * Each engine keeps its own board, transposition table and search state, so separate
+ * engines can be used from separate threads at the same time. Calls on one engine must
+ * not overlap, except blupig_stop.
+ */
+
+#include <stdint.h>
+
+/* Marks the functions exported by libblupig, which hides all other symbols */
+#if defined(__GNUC__) || defined(__clang__)
+#define BLUPIG_EXPORT __attribute__((visibility("default")))
+#else
+#define BLUPIG_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented when the interface changes incompatibly */
+#define BLUPIG_API_VERSION 1
+
+/* Return codes */
+#define BLUPIG_OK                    0
+#define BLUPIG_ERROR_INVALID_ARGUMENT -1
+#define BLUPIG_ERROR_INVALID_STATE   -2
+#define BLUPIG_ERROR_INTERNAL        -3
+
+/* Game state formats, see RenjuAPIStateFormat */
+#define BLUPIG_STATE_DIGITS 0
+#define BLUPIG_STATE_PACKED 1
+#define BLUPIG_STATE_MOVES  2
+
+/* Options for blupig_set_option */
+#define BLUPIG_OPTION_SEARCH_DEPTH 0  /* Fixed search depth, -1 for iterative deepening (default: -1) */
+#define BLUPIG_OPTION_TIME_LIMIT   1  /* Time limit of iterative deepening in ms (default: 5500) */
+#define BLUPIG_OPTION_THREADS      2  /* Search threads (default: 1) */
+#define BLUPIG_OPTION_TT_SIZE      3  /* Transposition table size in MB, 0 disables it (default: 16) */
+
+typedef struct blupig_engine blupig_engine;
+
+typedef struct blupig_result {
+    int move_r;
+    int move_c;
+    int winning_player;     /* 0 if nobody wins by this move */
+    int search_depth;       /* Depth of the last completed iteration */
+    uint64_t node_count;
+    uint64_t eval_count;
+    int64_t elapsed_ms;
+} blupig_result;
+
+/* Called after each completed iteration with the move found so far,
+ * return nonzero to stop the search and keep this move */
+typedef int (*blupig_iteration_callback)(void *user_data, int depth, int score, int move_r, int move_c);
+
+/* Returns BLUPIG_API_VERSION of the library */
+BLUPIG_EXPORT int blupig_api_version(void);
+
+/* Create an engine for a board_size x board_size board (5 to 20), NULL on failure */
+BLUPIG_EXPORT blupig_engine *blupig_create(int board_size);
+
+BLUPIG_EXPORT void blupig_destroy(blupig_engine *engine);
+
+/* Set one of the BLUPIG_OPTION_* options */
+BLUPIG_EXPORT int blupig_set_option(blupig_engine *engine, int option, int value);
+
+/* Search a move for ai_player (1: black, 2: white) in the given state (NUL-terminated,
+ * in one of the BLUPIG_STATE_* formats). callback may be NULL */
+BLUPIG_EXPORT int blupig_search(blupig_engine *engine, const char *state, int format, int ai_player,
+                                blupig_iteration_callback callback, void *user_data, blupig_result *result);
+
+/* Stop the search running on engine as soon as possible, safe to call from any thread.
+ * The stop applies to the blupig_search call in progress; if none is, the next call
+ * returns right away without a move (move_r and move_c are -1, search_depth is 0) */
+BLUPIG_EXPORT void blupig_stop(blupig_engine *engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* INCLUDE_API_BLUPIG_H_ */
@@ -19,7 +19,59 @@
 #ifndef INCLUDE_API_RENJU_API_H_
 #define INCLUDE_API_RENJU_API_H_
 
+#include <ai/search_context.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+
+// Encodings of a game state accepted by RenjuAPI
+enum RenjuAPIStateFormat {
+    // board_size * board_size characters of '0', '1' or '2', row by row
+    kRenjuAPIStateDigits = 0,
+
+    // 2 bits per cell, 4 cells per byte starting from the low bits, as unpadded base64url text
+    // (76 characters on a 15x15 board)
+    kRenjuAPIStatePacked = 1,
+
+    // Moves in playing order starting with black, each a column letter and a 1-based row, e.g. "h8i9h10"
+    kRenjuAPIStateMoves = 2
+};
+
+// One position for RenjuAPI::generateMoves, defaults match the CLI
+struct RenjuAPIMoveRequest {
+    RenjuAPIMoveRequest() :
+        state_format(kRenjuAPIStateDigits), board_size(15), ai_player_id(1),
+        search_depth(-1), time_limit(5500), node_limit(0), num_threads(1) {}
+
+    std::string gs_string;  // game state encoded in state_format
+    int state_format;       // RenjuAPIStateFormat
+    int board_size;
+    int ai_player_id;
+    int search_depth;
+    int time_limit;
+    uint64_t node_limit;    // node budget replacing time_limit when not 0, see RenjuAISearchContext
+    int num_threads;
+};
+
+// Result of one RenjuAPIMoveRequest
+struct RenjuAPIMoveResult {
+    RenjuAPIMoveResult() :
+        success(false), actual_depth(0), move_r(-1), move_c(-1), winning_player(0),
+        node_count(0), eval_count(0), pm_count(0), cpu_time(0) {}
+
+    bool success;           // false if the request was invalid
+    int actual_depth;
+    int move_r;
+    int move_c;
+    int winning_player;
+    uint64_t node_count;
+    uint64_t eval_count;
+    uint64_t pm_count;
+    int cpu_time;           // CPU time of the threads that searched this position (ms)
+    std::vector<RenjuAIIterationStats> iterations;  // completed iterations of the search
+};
 
 class RenjuAPI {
  public:
@@ -30,11 +82,41 @@ class RenjuAPI {
     static bool generateMove(const char *gs_string, int ai_player_id,
                              int search_depth, int time_limit, int num_threads,
                              int *actual_depth, int *move_r, int *move_c, int *winning_player,
-                             unsigned int *node_count, unsigned int *eval_count, unsigned int *pm_count);
+                             uint64_t *node_count, uint64_t *eval_count, uint64_t *pm_count,
+                             uint64_t node_limit = 0);
+
+    // Generate moves for count positions, scheduled across num_workers threads
+    // (0: one per core). results[i] answers requests[i]
+    // The workers share the process-wide transposition table, it cannot be resized while the batch runs
+    static void generateMoves(const RenjuAPIMoveRequest *requests, size_t count, RenjuAPIMoveResult *results,
+                              int num_workers = 0);
+
+    // Generate a move for one request. ctx is the calling thread's search context,
+    // created or replaced when the board size changes and reused between calls
+    static void generateMove(const RenjuAPIMoveRequest &request, RenjuAPIMoveResult *result,
+                             std::unique_ptr<RenjuAISearchContext> *ctx);
+
+    // Set transposition table size in megabytes (0 disables the table)
+    // Returns false for an invalid size, or while a search is using the shared table
+    static bool setTranspositionTableSize(int size_mb);
 
     // Convert a game state string to game state binary array
     static void gsFromString(const char *gs_string, char *gs);
 
+    // Decode a game state in any RenjuAPIStateFormat into gs (board_size * board_size cells),
+    // returns false if it is malformed
+    static bool parseGameState(const std::string &state, int format, int board_size, char *gs);
+
+    // Encode a game state as digits or packed text (moves cannot be recovered from a position)
+    static std::string formatGameState(const char *gs, int board_size, int format);
+
+    // Binary packed game state: ceil(board_size * board_size / 4) bytes, 2 bits per cell
+    static bool gsFromPacked(const unsigned char *data, size_t size, int board_size, char *gs);
+    static void gsToPacked(const char *gs, int board_size, std::vector<unsigned char> *data);
+
+    // Format by name ("digits", "packed" or "moves"), -1 if unknown
+    static int stateFormatFromName(const std::string &name);
+
  private:
     // Render game state into text
     static std::string renderGameState(const char *gs);
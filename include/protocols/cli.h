@@ -19,9 +19,13 @@
 #ifndef INCLUDE_PROTOCOLS_CLI_H_
 #define INCLUDE_PROTOCOLS_CLI_H_
 
+#include <utils/json.h>
 #include <string>
 #include <unordered_map>
 
+// Batch mode reads this many requests per worker before searching them
+#define kRenjuCLIBatchRequestsPerWorker 4
+
 class RenjuProtocolCLI {
  public:
     RenjuProtocolCLI();
@@ -31,19 +35,25 @@ class RenjuProtocolCLI {
 
     // Generate move and responds in json
     static std::string generateMove(const char *gs_string, int ai_player_id, int search_depth,
-                                    int time_limit, int num_threads);
+                                    int time_limit, int num_threads, int node_limit = 0);
 
- private:
-    // Validates a string and parses into an integer
+    // Parses a decimal integer of at most max_length characters, shared by the protocols' options.
+    // Empty strings and trailing characters are rejected, result is unchanged then
     static bool parseIntegerArgument(const char *str, int max_length, int *result);
 
+ private:
+    // Batch mode: search NDJSON requests from stdin, writing responses in input order
+    static bool generateMoves(int num_workers);
+
     // Validates a string and returns the length.
     // If fails validation, -1 is returned.
     static int validateString(const char *str, int max_length);
 
     // Generate json response
+    // iterations, if given, is added to the result as "iterations"
     static std::string generateResultJson(const std::unordered_map<std::string, std::string> *data,
-                                          const std::string &message);
+                                          const std::string &message,
+                                          const nlohmann::json *iterations = nullptr);
 };
 
 #endif  // INCLUDE_PROTOCOLS_CLI_H_
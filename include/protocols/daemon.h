@@ -0,0 +1,118 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_PROTOCOLS_DAEMON_H_
+#define INCLUDE_PROTOCOLS_DAEMON_H_
+
+#include <ai/search_context.h>
+#include <api/renju_api.h>
+#include <utils/json.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Long-running engine speaking line-delimited JSON over stdin/stdout or a Unix socket
+//
+// Each request is one JSON object per line:
+//   {"id": <any>, "s": <state>, "f": <format>, "p": <ai_player>, "d": <depth>, "l": <time_limit>, "n": <node_limit>,
+//    "t": <threads>, "size": <board_size>}
+// Only "s" is required. "f" is the state's encoding: "digits" (default), "packed" or "moves",
+// see RenjuAPIStateFormat. A non-zero "n" bounds iterative deepening by searched nodes instead
+// of time, which makes single-threaded searches reproducible. Responses are written one per line as soon as a worker
+// finishes, so requests can be pipelined; "id" is echoed back to match them:
+//   {"id": <any>, "message": "ok", "result": {...}}
+// The result has the CLI's fields, including "iterations" with statistics of every completed
+// iteration (depth, time, nodes, branching factor, cutoff and TT hit rates, move, score and PV).
+// All workers share the process-wide transposition table.
+class RenjuProtocolDaemon {
+ public:
+    RenjuProtocolDaemon();
+    ~RenjuProtocolDaemon();
+
+    static bool beginSession(int argc, char const *argv[]);
+
+    // Handle one request line, using the worker's own search context
+    static std::string handleRequest(const std::string &line, std::unique_ptr<RenjuAISearchContext> *ctx);
+
+    // Parse a request line into a move request, returns false if it is invalid.
+    // id receives the request's "id" (null if absent), also for invalid requests
+    static bool parseRequest(const std::string &line, RenjuAPIMoveRequest *request, nlohmann::json *id);
+
+    // Format the response line for a request; an unsuccessful result gives the error response
+    static std::string formatResponse(const nlohmann::json &id, const RenjuAPIMoveRequest &request,
+                                      const RenjuAPIMoveResult &result);
+
+    // Per-iteration search statistics as a JSON array, shared by the CLI and daemon results
+    static nlohmann::json formatIterations(const std::vector<RenjuAIIterationStats> &iterations);
+
+ private:
+    // Where responses to a request are written
+    class Connection {
+     public:
+        explicit Connection(int fd) : fd(fd) {}
+        ~Connection();
+
+        // Write a line, serialized with other workers answering on this connection
+        void writeLine(const std::string &line);
+
+        // Make a blocked read on the connection return end of file
+        void shutdownRead();
+
+     private:
+        int fd;
+        std::mutex mutex;
+    };
+
+    struct Job {
+        std::string line;
+        std::shared_ptr<Connection> connection;
+    };
+
+    // Thread reading requests from a socket client
+    struct Reader {
+        std::thread thread;
+        std::weak_ptr<Connection> connection;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    // Requests waiting for a worker
+    static std::deque<Job> jobs;
+    static std::mutex jobs_mutex;
+    static std::condition_variable jobs_cv;
+    static bool shutting_down;
+
+    static void workerLoop();
+    static void enqueue(const std::string &line, const std::shared_ptr<Connection> &connection);
+
+    // Read request lines from a file descriptor until it is closed
+    static void readConnection(int fd, std::shared_ptr<Connection> connection);
+
+    // Accept clients on a Unix socket, each served by its own reader thread.
+    // Only returns when the socket fails, returning false
+    static bool serveSocket(const char *path);
+
+    // Join the readers that are done, or all of them after shutting down their connections
+    static void joinReaders(std::vector<Reader> *readers, bool all);
+};
+
+#endif  // INCLUDE_PROTOCOLS_DAEMON_H_
@@ -19,7 +19,13 @@
 #ifndef INCLUDE_PROTOCOLS_GOMOCUP_H_
 #define INCLUDE_PROTOCOLS_GOMOCUP_H_
 
+#include <ai/engine.h>
+#include <protocols/gomocup_time.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include <thread>
 
 class RenjuProtocolGomocup {
  public:
@@ -29,7 +35,42 @@ class RenjuProtocolGomocup {
     static bool beginSession(int argc, char const *argv[]);
 
  private:
-    static void performAndWriteMove(char *gs_string, int time_limit);
+    // Number of search threads
+    static int num_threads;
+
+    // Transposition table size given with -m, -1 when not specified
+    static int tt_size;
+
+    // Engine kept for the whole session, holding the board, caches and transposition table
+    static RenjuAIEngine *engine;
+
+    // Time and memory limits received from the manager
+    static RenjuProtocolGomocupTime time;
+
+    // Search running on the opponent's time
+    struct Ponder {
+        bool enabled;                // Enabled with -p
+        std::thread thread;
+        std::atomic<bool> stop;
+        std::atomic<bool> done;      // Reached the maximum depth before being stopped
+        std::chrono::steady_clock::time_point start;
+        int elapsed;                 // Time spent pondering (ms)
+        bool found;                  // Whether there was a reply to ponder on
+        uint64_t hash;               // Board hash after the predicted reply
+        int actual_depth;
+        int move_r;
+        int move_c;
+    };
+    static Ponder ponder;
+
+    static void startPondering();
+    static void stopPondering();
+    static bool ponderHit(int time_limit, int *actual_depth, int *move_r, int *move_c);
+
+    static void performAndWriteMove();
+    static bool performMove(int *move_r, int *move_c);
+    static void performSwap2(const int moves[][2], int move_count);
+    static void handleInfo(const char *line);
     static void splitLine(const char *line, int *output);
     static void writeStdout(std::string str);
 };
@@ -0,0 +1,62 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_PROTOCOLS_GOMOCUP_TIME_H_
+#define INCLUDE_PROTOCOLS_GOMOCUP_TIME_H_
+
+// Time reserved for protocol I/O and process scheduling (ms)
+#define kGomocupTimeMargin 100
+
+// Number of own moves a game is expected to last, and the fewest
+// remaining moves the match time is ever split across
+#define kGomocupTimeExpectedMoves 40
+#define kGomocupTimeMinMovesLeft 10
+
+// Fraction of max_memory given to the transposition table
+#define kGomocupTimeMemoryRatio 0.5
+
+// Time and memory allocation from the limits a Gomocup manager sends with INFO
+class RenjuProtocolGomocupTime {
+ public:
+    RenjuProtocolGomocupTime();
+
+    // Handle an INFO [key] [value] line, returns false for unrelated keys
+    // key is matched as a whole
+    bool setInfo(const char *key, long long value);
+
+    // Time budget (ms) for the next move: the remaining match time split across
+    // the expected remaining moves, capped by the per-turn limit
+    // own_moves: number of stones the engine has already placed
+    int turnTimeLimit(int own_moves) const;
+
+    // Charge the time spent on a move against the remaining match time,
+    // until the manager reports time_left again
+    void moveFinished(int elapsed);
+
+    // Transposition table size (MB) fitting in max_memory,
+    // -1 when max_memory is unlimited
+    int transpositionTableSize() const;
+
+ private:
+    long long timeout_turn;   // Per-turn limit (ms), 0 means play as fast as possible
+    long long timeout_match;  // Per-match limit (ms), 0 means unlimited
+    long long time_left;      // Remaining match time (ms), -1 when unknown
+    long long max_memory;     // Memory limit (bytes), 0 means unlimited
+};
+
+#endif  // INCLUDE_PROTOCOLS_GOMOCUP_TIME_H_
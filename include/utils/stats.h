@@ -0,0 +1,129 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef INCLUDE_UTILS_STATS_H_
+#define INCLUDE_UTILS_STATS_H_
+
+// 估值、着法生成和搜索的计数器与计时器，仅在定义 BLUPIG_STATS 时编译（cmake -DENABLE_STATS=ON）
+// 计时包含内层调用，只用于比较各层的开销
+
+#include <cstdint>
+
+// 计数器
+enum RenjuStatsCounter {
+    kRenjuStatsEvalMove = 0,         // RenjuAIEval::evalMove 调用次数
+    kRenjuStatsEvalADM,              // 得分表查询
+    kRenjuStatsMatchPattern,         // RenjuAIEval::matchPattern 调用次数
+    kRenjuStatsMeasureDirection,     // 超出查表窗口的方向测量
+    kRenjuStatsHeuristicCacheHit,    // RenjuAIBoard::heuristic 命中缓存
+    kRenjuStatsHeuristicCacheMiss,   // RenjuAIBoard::heuristic 未命中缓存
+    kRenjuStatsMoveGen,              // RenjuAINegamax::searchMovesOrdered 调用次数
+    kRenjuStatsMoveGenCandidates,    // 着法生成打分的候选点
+    kRenjuStatsNode,                 // 搜索节点
+    kRenjuStatsTTProbe,              // 置换表查询
+    kRenjuStatsTTHit,                // 置换表命中
+    kRenjuStatsBetaCutoff,           // Beta 剪枝
+    kRenjuStatsCounterCount
+};
+
+// 计时器
+enum RenjuStatsTimer {
+    kRenjuStatsTimerSearch = 0,      // RenjuAINegamax::search
+    kRenjuStatsTimerIteration,       // 一轮迭代（或固定深度搜索）
+    kRenjuStatsTimerMoveGen,         // RenjuAINegamax::searchMovesOrdered
+    kRenjuStatsTimerEvalMove,        // 对整个棋盘的 RenjuAIEval::evalMove
+    kRenjuStatsTimerCount
+};
+
+#ifdef BLUPIG_STATS
+
+#include <utils/json.h>
+#include <atomic>
+#include <chrono>
+
+class RenjuStats {
+ public:
+    static inline void count(RenjuStatsCounter counter, uint64_t n = 1) {
+        std::atomic<uint64_t> &value = local()->counts[counter];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static inline void addTime(RenjuStatsTimer timer, uint64_t ns) {
+        Block *block = local();
+        block->timer_calls[timer].store(block->timer_calls[timer].load(std::memory_order_relaxed) + 1,
+                                        std::memory_order_relaxed);
+        block->timer_ns[timer].store(block->timer_ns[timer].load(std::memory_order_relaxed) + ns,
+                                     std::memory_order_relaxed);
+    }
+
+    // 清零所有线程的计数
+    static void reset();
+
+    // 所有线程的合计：{"counters": {名称: 次数}, "timers": {名称: {"calls", "ms"}}}
+    static nlohmann::json toJson();
+
+ private:
+    // 每个线程一块，按缓存行对齐，只由所属线程写入
+    struct alignas(64) Block {
+        std::atomic<uint64_t> counts[kRenjuStatsCounterCount];
+        std::atomic<uint64_t> timer_calls[kRenjuStatsTimerCount];
+        std::atomic<uint64_t> timer_ns[kRenjuStatsTimerCount];
+    };
+
+    static thread_local Block *thread_block;
+
+    static inline Block *local() {
+        if (thread_block == nullptr) thread_block = registerThread();
+        return thread_block;
+    }
+
+    // 分配当前线程的计数块，线程退出后保留
+    static Block *registerThread();
+};
+
+class RenjuStatsScopedTimer {
+ public:
+    explicit RenjuStatsScopedTimer(RenjuStatsTimer timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+    ~RenjuStatsScopedTimer() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        RenjuStats::addTime(timer, static_cast<uint64_t>(ns.count()));
+    }
+
+ private:
+    RenjuStatsTimer timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define BLUPIG_STATS_CONCAT_(a, b) a##b
+#define BLUPIG_STATS_CONCAT(a, b) BLUPIG_STATS_CONCAT_(a, b)
+
+#define BLUPIG_STATS_COUNT(counter) RenjuStats::count(counter)
+#define BLUPIG_STATS_ADD(counter, n) RenjuStats::count(counter, n)
+#define BLUPIG_STATS_TIMER(timer) \
+    RenjuStatsScopedTimer BLUPIG_STATS_CONCAT(blupig_stats_timer_, __LINE__)(timer)
+
+#else
+
+#define BLUPIG_STATS_COUNT(counter) do {} while (0)
+#define BLUPIG_STATS_ADD(counter, n) do {} while (0)
+#define BLUPIG_STATS_TIMER(timer) do {} while (0)
+
+#endif  // BLUPIG_STATS
+
+#endif  // INCLUDE_UTILS_STATS_H_
@@ -17,26 +17,37 @@
  */
 
 #include <ai/ai_controller.h>
-#include <ai/eval.h>
 #include <ai/negamax.h>
-#include <ai/utils.h>
-#include <utils/globals.h>
-#include <cstring>
+#include <climits>
+
+// 预测对方应对时的搜索深度
+#define kRenjuAiPonderPredictDepth 4
 
 // 暴露出用于外部调用的方法，调用本目录下的其他代码产生下一步的下法
-void RenjuAIController::generateMove(const char *gs, int player, int search_depth, int time_limit,
-                           int *actual_depth, int *move_r, int *move_c, int *winning_player,
-                           unsigned int *node_count, unsigned int *eval_count, unsigned int *pm_count) {
+// ctx提供棋盘尺寸和时间预算，搜索的计数器也记录在ctx中
+void RenjuAIController::generateMove(RenjuAISearchContext *ctx, const char *gs, int player, int search_depth,
+                                     int num_threads, int *actual_depth, int *move_r, int *move_c,
+                                     int *winning_player) {
+    if (ctx == nullptr || gs == nullptr) return;
+
+    // 把游戏状态载入上下文的位棋盘
+    ctx->board.load(gs);
+    generateMove(ctx, player, search_depth, num_threads, actual_depth, move_r, move_c, winning_player);
+}
+
+void RenjuAIController::generateMove(RenjuAISearchContext *ctx, int player, int search_depth,
+                                     int num_threads, int *actual_depth, int *move_r, int *move_c,
+                                     int *winning_player) {
     // 检查参数
-    if (gs == nullptr ||
+    if (ctx == nullptr ||
         player  < 1 || player > 2 ||
         search_depth == 0 || search_depth > 10 ||
-        time_limit < 0 ||
+        ctx->time_limit < 0 ||
+        num_threads < 1 ||
         move_r == nullptr || move_c == nullptr) return;
 
-    // 全局计数器，每一步都会统计评估次数和局势棋谱配对次数
-    g_eval_count = 0;
-    g_pm_count = 0;
+    // 每一步都重新统计结点数、评估次数和局势棋谱配对次数
+    ctx->resetCounters();
 
     // 初始化数据
     *move_r = -1;
@@ -45,31 +56,89 @@ void RenjuAIController::generateMove(const char *gs, int player, int search_dept
     if (actual_depth != nullptr) *actual_depth = 0;
 
     // 检查是否有玩家获胜
-    _winning_player = RenjuAIEval::winningPlayer(gs);
+    _winning_player = ctx->board.winningPlayer();
     if (_winning_player != 0) {
         if (winning_player != nullptr) *winning_player = _winning_player;
         return;
     }
 
-    // 备份游戏状态
-    char *_gs = new char[g_gs_size];
-    std::memcpy(_gs, gs, g_gs_size);
-
     // 运行启发式Negamax算法
-    RenjuAINegamax::heuristicNegamax(_gs, player, search_depth, time_limit, true, actual_depth, move_r, move_c);
-
-    // 备份游戏状态，下棋并将走棋方式通过move_r和move_c输出
-    std::memcpy(_gs, gs, g_gs_size);
-    RenjuAIUtils::setCell(_gs, *move_r, *move_c, static_cast<char>(player));
+    RenjuAINegamax::search(ctx, player, search_depth, true, actual_depth, move_r, move_c, num_threads);
 
-    // 检查是否有获胜的
-    _winning_player = RenjuAIEval::winningPlayer(_gs);
+    // 搜索结束后棋盘已还原，将走棋方式通过move_r和move_c输出
+    // 下棋前没有人获胜，所以只需检查经过这一步的四条线
+    if (ctx->board.cell(*move_r, *move_c) == 0 && ctx->board.fiveAt(*move_r, *move_c, player))
+        _winning_player = player;
 
     // 输出
     if (winning_player != nullptr) *winning_player = _winning_player;
-    if (node_count != nullptr) *node_count = g_node_count;
-    if (eval_count != nullptr) *eval_count = g_eval_count;
-    if (pm_count != nullptr) *pm_count = g_pm_count;
+}
+
+void RenjuAIController::ponder(RenjuAISearchContext *ctx, const char *gs, int player, int num_threads,
+                               int *predicted_r, int *predicted_c, int *actual_depth, int *move_r, int *move_c) {
+    if (ctx == nullptr || gs == nullptr || predicted_r == nullptr || predicted_c == nullptr) return;
+
+    ctx->board.load(gs);
+    *predicted_r = -1;
+    *predicted_c = -1;
+    ponder(ctx, player, num_threads, predicted_r, predicted_c, actual_depth, move_r, move_c);
+}
+
+void RenjuAIController::ponder(RenjuAISearchContext *ctx, int player, int num_threads,
+                               int *predicted_r, int *predicted_c, int *actual_depth, int *move_r, int *move_c) {
+    // 检查参数
+    if (ctx == nullptr ||
+        player < 1 || player > 2 ||
+        num_threads < 1 ||
+        predicted_r == nullptr || predicted_c == nullptr ||
+        move_r == nullptr || move_c == nullptr) return;
+
+    ctx->resetCounters();
+    *move_r = -1;
+    *move_c = -1;
+    if (actual_depth != nullptr) *actual_depth = 0;
+    RenjuAIBoard *board = &ctx->board;
+    int opponent = player == 1 ? 2 : 1;
+
+    // 已经有人获胜就不用再想了
+    if (board->winningPlayer() != 0) {
+        *predicted_r = -1;
+        *predicted_c = -1;
+        return;
+    }
+
+    // 没有可用的提示时，刚才的搜索已经在置换表里保存了对方的最佳应对，也没有时做一次浅的搜索
+    if (*predicted_r < 0 || board->cell(*predicted_r, *predicted_c) != 0) {
+        *predicted_r = -1;
+        *predicted_c = -1;
+        RenjuAINegamax::SharedTableUse shared_table_use(ctx);
+        RenjuAITranspositionTable *tt = ctx->transposition_table;
+        if (tt == nullptr) tt = RenjuAINegamax::sharedTranspositionTable();
+        RenjuAITranspositionTable::Entry tt_entry;
+        if (tt->probe(board->key(opponent), &tt_entry) && tt_entry.move_r >= 0 &&
+            board->cell(tt_entry.move_r, tt_entry.move_c) == 0) {
+            *predicted_r = tt_entry.move_r;
+            *predicted_c = tt_entry.move_c;
+        } else {
+            RenjuAINegamax::search(ctx, opponent, kRenjuAiPonderPredictDepth, true, nullptr,
+                                   predicted_r, predicted_c);
+        }
+        if (ctx->stopped() || *predicted_r < 0 || board->cell(*predicted_r, *predicted_c) != 0) {
+            *predicted_r = -1;
+            *predicted_c = -1;
+            return;
+        }
+    }
+
+    // 在预测的局面上不限时地迭代加深，由停止标志结束；对方连五就不用再想了
+    board->make(*predicted_r, *predicted_c, opponent);
+    if (!board->fiveAt(*predicted_r, *predicted_c, opponent)) {
+        ctx->time_limit = INT_MAX;
+        RenjuAINegamax::search(ctx, player, -1, true, actual_depth, move_r, move_c, num_threads);
+    }
+    board->unmake(*predicted_r, *predicted_c);
+}
 
-    delete[] _gs;
+bool RenjuAIController::setTranspositionTableSize(int size_mb) {
+    return RenjuAINegamax::setTranspositionTableSize(size_mb);
 }
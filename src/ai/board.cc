@@ -0,0 +1,193 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ai/board.h>
+#include <ai/eval.h>
+#include <ai/search_context.h>
+#include <algorithm>
+#include <cstring>
+
+// Zobrist哈希的随机数，程序启动时生成
+uint64_t RenjuAIBoard::zobrist_keys[2][kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize + kRenjuAiMaxBoardSize + 1];
+bool RenjuAIBoard::zobrist_initialized = RenjuAIBoard::initZobristKeys();
+
+const int RenjuAIBoard::kInvalidHeuristic;
+
+const unsigned char RenjuAIBoard::reversed_bits[32] = {
+    0, 16,  8, 24, 4, 20, 12, 28, 2, 18, 10, 26, 6, 22, 14, 30,
+    1, 17,  9, 25, 5, 21, 13, 29, 3, 19, 11, 27, 7, 23, 15, 31
+};
+
+RenjuAIBoard::RenjuAIBoard(int board_size) :
+    board_size(board_size),
+    zobrist_hash(zobrist_keys[1][kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize + board_size]),
+    stone_count(0) {
+    memset(gs, 0, sizeof(gs));
+    memset(lines, 0, sizeof(lines));
+    memset(line_masks, 0, sizeof(line_masks));
+    memset(neighbor_counts, 0, sizeof(neighbor_counts));
+    memset(candidate_rows, 0, sizeof(candidate_rows));
+    for (int r = 0; r < board_size; ++r) {
+        for (int c = 0; c < board_size; ++c) {
+            for (int direction = 0; direction < 4; ++direction) {
+                line_masks[direction][lineIndex(direction, r, c)] |=
+                    1u << (linePos(direction, r, c) + kRenjuAiBoardLinePadding);
+            }
+        }
+    }
+    saved_heuristics.reserve(kRenjuAiMaxSearchDepth * 4 * 2 * kRenjuAiMaxBoardSize);
+    saved_counts.reserve(kRenjuAiMaxSearchDepth * 2);
+    std::fill(&heuristic_cache[0][0], &heuristic_cache[0][0] + 2 * kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize,
+              kInvalidHeuristic);
+}
+
+void RenjuAIBoard::load(const char *gs) {
+    int gs_size = board_size * board_size;
+    memcpy(this->gs, gs, gs_size);
+    zobrist_hash = zobrist_keys[1][kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize + board_size];
+    memset(lines, 0, sizeof(lines));
+    memset(neighbor_counts, 0, sizeof(neighbor_counts));
+    memset(candidate_rows, 0, sizeof(candidate_rows));
+    stone_count = 0;
+    for (int i = 0; i < gs_size; ++i) {
+        if (gs[i] == 1 || gs[i] == 2) {
+            int r = i / board_size, c = i % board_size;
+            RenjuAIUtils::zobristToggle(&zobrist_hash, zobrist_keys[0], zobrist_keys[1], kRenjuAiMaxBoardSize,
+                                        r, c, gs[i]);
+            toggleBits(r, c, gs[i]);
+            updateCandidates(r, c, 1);
+        }
+    }
+    std::fill(&heuristic_cache[0][0], &heuristic_cache[0][0] + 2 * kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize,
+              kInvalidHeuristic);
+    saved_heuristics.clear();
+    saved_counts.clear();
+}
+
+void RenjuAIBoard::make(int r, int c, int player) {
+    invalidateLines(r, c, true);
+    gs[board_size * r + c] = static_cast<char>(player);
+    RenjuAIUtils::zobristToggle(&zobrist_hash, zobrist_keys[0], zobrist_keys[1], kRenjuAiMaxBoardSize, r, c, player);
+    toggleBits(r, c, player);
+    updateCandidates(r, c, 1);
+}
+
+void RenjuAIBoard::unmake(int r, int c) {
+    int player = gs[board_size * r + c];
+    gs[board_size * r + c] = 0;
+    RenjuAIUtils::zobristToggle(&zobrist_hash, zobrist_keys[0], zobrist_keys[1], kRenjuAiMaxBoardSize, r, c, player);
+    toggleBits(r, c, player);
+    updateCandidates(r, c, -1);
+
+    // 恢复make之前的缓存
+    int count = saved_counts.back();
+    saved_counts.pop_back();
+    for (int i = 0; i < count; ++i) {
+        const SavedHeuristic &saved = saved_heuristics.back();
+        heuristic_cache[0][saved.index] = saved.score[0];
+        heuristic_cache[1][saved.index] = saved.score[1];
+        saved_heuristics.pop_back();
+    }
+}
+
+void RenjuAIBoard::place(int r, int c, int player) {
+    invalidateLines(r, c, false);
+    gs[board_size * r + c] = static_cast<char>(player);
+    RenjuAIUtils::zobristToggle(&zobrist_hash, zobrist_keys[0], zobrist_keys[1], kRenjuAiMaxBoardSize, r, c, player);
+    toggleBits(r, c, player);
+    updateCandidates(r, c, 1);
+}
+
+void RenjuAIBoard::remove(int r, int c) {
+    int player = gs[board_size * r + c];
+    invalidateLines(r, c, false);
+    gs[board_size * r + c] = 0;
+    RenjuAIUtils::zobristToggle(&zobrist_hash, zobrist_keys[0], zobrist_keys[1], kRenjuAiMaxBoardSize, r, c, player);
+    toggleBits(r, c, player);
+    updateCandidates(r, c, -1);
+}
+
+void RenjuAIBoard::invalidateLines(int r, int c, bool save) {
+    // 评估某格时可能沿四条线一直测量到棋盘边界，所以整条线都要失效
+    // 落子点本身只处理一次
+    static const int directions[4][2] = {{0, 1}, {1, 1}, {1, 0}, {1, -1}};
+    int count = 0;
+    for (int i = 0; i < 4; ++i) {
+        for (int side = -1; side <= 1; side += 2) {
+            int dr = directions[i][0] * side, dc = directions[i][1] * side;
+            for (int cr = side == -1 ? r : r + dr, cc = side == -1 ? c : c + dc;
+                 cr >= 0 && cr < board_size && cc >= 0 && cc < board_size;
+                 cr += dr, cc += dc) {
+                if (cr == r && cc == c && i > 0) continue;
+                int index = board_size * cr + cc;
+                if (save) {
+                    SavedHeuristic saved = {index, {heuristic_cache[0][index], heuristic_cache[1][index]}};
+                    saved_heuristics.push_back(saved);
+                    ++count;
+                }
+                heuristic_cache[0][index] = kInvalidHeuristic;
+                heuristic_cache[1][index] = kInvalidHeuristic;
+            }
+        }
+    }
+    if (save) saved_counts.push_back(count);
+}
+
+void RenjuAIBoard::toggleBits(int r, int c, int player) {
+    for (int direction = 0; direction < 4; ++direction) {
+        lines[player - 1][direction][lineIndex(direction, r, c)] ^=
+            1u << (linePos(direction, r, c) + kRenjuAiBoardLinePadding);
+    }
+    stone_count += gs[board_size * r + c] != 0 ? 1 : -1;
+}
+
+void RenjuAIBoard::updateCandidates(int r, int c, int delta) {
+    int r_begin = std::max(r - 2, 0), r_end = std::min(r + 2, board_size - 1);
+    int c_begin = std::max(c - 2, 0), c_end = std::min(c + 2, board_size - 1);
+    for (int i = r_begin; i <= r_end; ++i) {
+        for (int j = c_begin; j <= c_end; ++j) {
+            int index = board_size * i + j;
+            neighbor_counts[index] = static_cast<unsigned char>(neighbor_counts[index] + delta);
+            if (neighbor_counts[index] > 0 && gs[index] == 0) candidate_rows[i] |= 1u << j;
+            else                                              candidate_rows[i] &= ~(1u << j);
+        }
+    }
+}
+
+bool RenjuAIBoard::hasFive(int player) const {
+    // 某条线的位图与自身右移1至4位的结果相与，不为0说明有连续5个棋子
+    int line_count[4] = {board_size, 2 * board_size - 1, board_size, 2 * board_size - 1};
+    for (int direction = 0; direction < 4; ++direction) {
+        const uint32_t *player_lines = lines[player - 1][direction];
+        for (int i = 0; i < line_count[direction]; ++i) {
+            uint32_t w = player_lines[i];
+            if (w & (w >> 1) & (w >> 2) & (w >> 3) & (w >> 4)) return true;
+        }
+    }
+    return false;
+}
+
+int RenjuAIBoard::evalMove(RenjuAISearchContext *ctx, int r, int c, int player) {
+    return RenjuAIEval::evalMove(ctx, *this, r, c, player);
+}
+
+bool RenjuAIBoard::initZobristKeys() {
+    RenjuAIUtils::zobristInit(kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize + kRenjuAiMaxBoardSize + 1,
+                              zobrist_keys[0], zobrist_keys[1]);
+    return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ai/engine.h>
+#include <ai/ai_controller.h>
+#include <ai/negamax.h>
+
+RenjuAIEngine::RenjuAIEngine(int board_size) :
+    ctx(board_size),
+    transposition_table_size(kRenjuAiTTDefaultSizeMB) {
+    ctx.transposition_table = &transposition_table;
+}
+
+void RenjuAIEngine::reset(int board_size) {
+    if (board_size < 1 || board_size > kRenjuAiMaxBoardSize) return;
+
+    // 不同尺寸的棋盘上同一格子的编号不同，置换表中的结果不能再用
+    if (board_size != ctx.board_size) transposition_table.clear();
+
+    RenjuAIIterationCallback callback = ctx.iteration_callback;
+    void *callback_data = ctx.iteration_callback_data;
+    ctx = RenjuAISearchContext(board_size);
+    ctx.transposition_table = &transposition_table;
+    setIterationCallback(callback, callback_data);
+    pv.clear();
+}
+
+void RenjuAIEngine::setTranspositionTableSize(int size_mb) {
+    if (size_mb < 0) return;
+    transposition_table_size = size_mb;
+    transposition_table.resize(size_mb);
+}
+
+bool RenjuAIEngine::play(int r, int c, int player) {
+    if (player < 1 || player > 2 || ctx.board.cell(r, c) != 0) return false;
+    ctx.board.place(r, c, player);
+    return true;
+}
+
+bool RenjuAIEngine::remove(int r, int c) {
+    if (ctx.board.cell(r, c) <= 0) return false;
+    ctx.board.remove(r, c);
+    return true;
+}
+
+void RenjuAIEngine::setPosition(const char *gs) {
+    // 先拿走不同的棋子再放上新的，没有变化的线上的缓存不受影响
+    const char *current = ctx.board.data();
+    for (int i = 0; i < ctx.gs_size; ++i) {
+        if (current[i] != 0 && current[i] != gs[i]) ctx.board.remove(i / ctx.board_size, i % ctx.board_size);
+    }
+    for (int i = 0; i < ctx.gs_size; ++i) {
+        if ((gs[i] == 1 || gs[i] == 2) && current[i] != gs[i])
+            ctx.board.place(i / ctx.board_size, i % ctx.board_size, gs[i]);
+    }
+}
+
+void RenjuAIEngine::generateMove(int player, int search_depth, int time_limit, int num_threads,
+                                 int *actual_depth, int *move_r, int *move_c, int *winning_player,
+                                 const std::atomic<bool> *stop) {
+    if (move_r == nullptr || move_c == nullptr) return;
+    allocateTranspositionTable();
+
+    int depth = 0;
+    ctx.time_limit = time_limit;
+    ctx.stop = stop;
+    RenjuAIController::generateMove(&ctx, player, search_depth, num_threads, &depth, move_r, move_c,
+                                    winning_player);
+    ctx.stop = nullptr;
+    if (actual_depth != nullptr) *actual_depth = depth;
+
+    RenjuAINegamax::principalVariation(&ctx, player, *move_r, *move_c, depth, &pv);
+}
+
+void RenjuAIEngine::setIterationCallback(RenjuAIIterationCallback callback, void *data) {
+    ctx.iteration_callback = callback;
+    ctx.iteration_callback_data = data;
+}
+
+void RenjuAIEngine::ponder(int player, int num_threads, const std::atomic<bool> *stop,
+                           int *predicted_r, int *predicted_c, int *actual_depth, int *move_r, int *move_c) {
+    if (predicted_r == nullptr || predicted_c == nullptr) return;
+    allocateTranspositionTable();
+
+    // 自己刚下的是主要变例的第一步时，第二步就是预测的对方应对
+    *predicted_r = -1;
+    *predicted_c = -1;
+    if (pv.size() >= 2 && ctx.board.cell(pv[0].r, pv[0].c) == player) {
+        *predicted_r = pv[1].r;
+        *predicted_c = pv[1].c;
+    }
+
+    ctx.stop = stop;
+    RenjuAIController::ponder(&ctx, player, num_threads, predicted_r, predicted_c, actual_depth, move_r, move_c);
+    ctx.stop = nullptr;
+}
+
+int RenjuAIEngine::evaluate(int player) {
+    if (player < 1 || player > 2) return 0;
+
+    int opponent = player == 1 ? 2 : 1;
+    int score = 0;
+    for (int r = 0; r < ctx.board_size; ++r) {
+        for (int c = 0; c < ctx.board_size; ++c) {
+            if (ctx.board.cell(r, c) != 0) continue;
+            score += ctx.board.heuristic(&ctx, r, c, player) - ctx.board.heuristic(&ctx, r, c, opponent);
+        }
+    }
+    return score;
+}
+
+void RenjuAIEngine::allocateTranspositionTable() {
+    if (!transposition_table.enabled() && transposition_table_size > 0)
+        transposition_table.resize(transposition_table_size);
+}
@@ -18,142 +18,116 @@
 
 #include <ai/eval.h>
 #include <ai/utils.h>
-#include <utils/globals.h>
+#include <utils/stats.h>
 #include <stdlib.h>
 #include <algorithm>
 #include <climits>
 #include <cstring>
 
-// 初始化棋谱变量
-RenjuAIEval::DirectionPattern *RenjuAIEval::preset_patterns = nullptr;
-int *RenjuAIEval::preset_scores = nullptr;
-int preset_patterns_size = 0;
-int preset_patterns_skip[6] = {0};
+// 棋谱和得分表
+constexpr RenjuAIEval::DirectionPattern RenjuAIEval::preset_patterns[];
+constexpr int RenjuAIEval::preset_scores[];
+constexpr int RenjuAIEval::preset_patterns_skip[];
+constexpr char RenjuAIEval::measurement_classes[];
+constexpr RenjuAIEval::DirectionMeasurement RenjuAIEval::measurement_class_representatives[];
+constexpr RenjuAIEval::ADMScoreTable RenjuAIEval::adm_score_table = RenjuAIEval::buildADMScoreTable();
 
-int RenjuAIEval::evalState(const char *gs, int player) {
+// 初始化局势表
+uint16_t RenjuAIEval::line_table[kRenjuAiEvalLineTableSize];
+uint16_t RenjuAIEval::line_table_base3[1 << (2 * kRenjuAiEvalLineWindow)];
+bool RenjuAIEval::line_table_initialized = RenjuAIEval::initLineTable();
+
+// 查表测量局势的方向，与measureAllDirections的方向顺序相同：右、右下、下、左下
+constexpr int RenjuAIEval::line_directions[4][2];
+
+static_assert(kRenjuAiBoardLinePadding >= kRenjuAiEvalLineWindow,
+              "board lines must be padded for the line window");
+
+int RenjuAIEval::evalState(RenjuAISearchContext *ctx, const char *gs, int player) {
     // 检查参数
     if (gs == nullptr ||
         player < 1 || player > 2) return 0;
 
     // 随意下，评估每一步
     int score = 0;
-    for (int r = 0; r < g_board_size; ++r) {
-        for (int c = 0; c < g_board_size; ++c) {
-            score += evalMove(gs, r, c, player);
+    for (int r = 0; r < ctx->board_size; ++r) {
+        for (int c = 0; c < ctx->board_size; ++c) {
+            score += evalMove(ctx, gs, r, c, player);
         }
     }
     return score;
 }
 
 // 用于在启发式Negamax算法中评估启发值
-int RenjuAIEval::evalMove(const char *gs, int r, int c, int player) {
+int RenjuAIEval::evalMove(RenjuAISearchContext *ctx, const char *gs, int r, int c, int player) {
     // Check parameters
     if (gs == nullptr ||
         player < 1 || player > 2) return 0;
 
-    // 全局评估次数增1
-    ++g_eval_count;
-
-    // 生成“棋谱”，下面会按棋谱招数计算得分
-    if (preset_patterns == nullptr) {
-        generatePresetPatterns(&preset_patterns, &preset_scores, &preset_patterns_size, preset_patterns_skip);
-    }
+    // 评估次数增1
+    ++ctx->eval_count;
+    BLUPIG_STATS_COUNT(kRenjuStatsEvalMove);
 
     // 对于某个下法，测量它8个方向上棋子的分布情况，可以认为是8个方向的“局势”
-    DirectionMeasurement adm[4];
+    // 不连续和连续的“局势”通过一次查表同时得到
+    DirectionMeasurement adm[4], adm_consecutive[4];
+    lookupAllDirections(ctx, gs, r, c, player, adm, adm_consecutive);
 
-    // 连续和不连续的统计“局势”
-    int max_score = 0;
-    for (bool consecutive = false;; consecutive = true) {
-        // 测量所有方向的“局势”
-        measureAllDirections(gs, r, c, player, consecutive, adm);
-
-        // 统计出了棋子分布情况（局势），通过不同方向的分布计算出不同的分数
-        int score = evalADM(adm);
-
-        // Prefer consecutive
-        // if (!consecutive) score *= 0.9;
+    // 统计出了棋子分布情况（局势），通过不同方向的分布计算出不同的分数
+    // 不要求方向上己方棋子连续和要求连续的分数取较高者
+    return std::max(evalADM(ctx, adm), evalADM(ctx, adm_consecutive));
+}
 
-        // 不要求方向上己方棋子连续
-        max_score = std::max(max_score, score);
+// 在搜索棋盘上评估启发值，局势窗口从位棋盘中取出
+int RenjuAIEval::evalMove(RenjuAISearchContext *ctx, const RenjuAIBoard &board, int r, int c, int player) {
+    ++ctx->eval_count;
+    BLUPIG_STATS_COUNT(kRenjuStatsEvalMove);
+    BLUPIG_STATS_TIMER(kRenjuStatsTimerEvalMove);
 
-        if (consecutive) break;
-    }
-    return max_score;
+    DirectionMeasurement adm[4], adm_consecutive[4];
+    lookupAllDirections(ctx, board, r, c, player, adm, adm_consecutive);
+    return std::max(evalADM(ctx, adm), evalADM(ctx, adm_consecutive));
 }
 
 // 通过某个下法测量出的各个方向的情况（“局势”），计算出分数
-int RenjuAIEval::evalADM(DirectionMeasurement *all_direction_measurement) {
-    int score = 0;
-    int size = preset_patterns_size;
-
-    // 每个方向评估出来的分数相加
-    // 每个方向棋子越长，分数越高，因为五子棋越长越好
-    // “棋谱”（present_patterns）内的下法有的长度超过了当前方向连续棋子的长度，
-    // 因此把这些棋谱忽略掉
-    int max_measured_len = 0;
-    for (int i = 0; i < 4; i++) {
-        int len = all_direction_measurement[i].length;
-        max_measured_len = len > max_measured_len ? len : max_measured_len;
-        score += len - 1;
+int RenjuAIEval::evalADM(RenjuAISearchContext *ctx, DirectionMeasurement *all_direction_measurement) {
+    // 查找得分表次数增1
+    ctx->pm_count++;
+    BLUPIG_STATS_COUNT(kRenjuStatsEvalADM);
+
+    // 得分与方向的顺序无关，把四个方向的类别从小到大排列后查表
+    int k[4];
+    for (int i = 0; i < 4; ++i) {
+        const DirectionMeasurement &dm = all_direction_measurement[i];
+        k[i] = measurement_classes[(dm.length - 1) * 6 + dm.block_count * 2 + dm.space_count];
     }
-    int start_pattern = preset_patterns_skip[max_measured_len];
-
-    // 将所有方向的“局势”与“棋谱”进行匹配，如果匹配到“棋谱”，按照棋谱的分数给分
-    for (int i = start_pattern; i < size; ++i) {
-        score += matchPattern(all_direction_measurement, &preset_patterns[2 * i]) * preset_scores[i];
+    if (k[0] > k[1]) std::swap(k[0], k[1]);
+    if (k[2] > k[3]) std::swap(k[2], k[3]);
+    if (k[0] > k[2]) std::swap(k[0], k[2]);
+    if (k[1] > k[3]) std::swap(k[1], k[3]);
+    if (k[1] > k[2]) std::swap(k[1], k[2]);
 
-        // 如果匹配到了“绝招”棋谱，直接退出，节省时间
-        if (score >= kRenjuAiEvalThreateningScore) break;
-    }
-
-    return score;
+    return adm_score_table.scores[rankClasses(k[0], k[1], k[2], k[3])];
 }
 
 // 将各个方向的“局势”与“棋谱”进行匹配
-int RenjuAIEval::matchPattern(DirectionMeasurement *all_direction_measurement,
-                              DirectionPattern *patterns) {
+int RenjuAIEval::matchPattern(RenjuAISearchContext *ctx,
+                              DirectionMeasurement *all_direction_measurement,
+                              const DirectionPattern *patterns) {
     // 检查参数
     if (all_direction_measurement == nullptr) return -1;
     if (patterns == nullptr) return -1;
 
-    // 全局查找“棋谱”次数增1
-    g_pm_count++;
-
-    int match_count = INT_MAX, single_pattern_match = 0;
-
-    // 每个方向的局势只查找两个棋谱
-    for (int i = 0; i < 2; ++i) {
-        auto p = patterns[i];
-        if (p.length == 0) break;
-
-        // Initialize counter
-        single_pattern_match = 0;
-
-        // 查找4个方向的局势
-        for (int j = 0; j < 4; ++j) {
-            auto dm = all_direction_measurement[j];
+    // 查找“棋谱”次数增1
+    ctx->pm_count++;
+    BLUPIG_STATS_COUNT(kRenjuStatsMatchPattern);
 
-            // 如果棋谱和局势完全匹配，匹配的数量增加
-            // 注意有的棋谱不要求block和space
-            if (dm.length == p.length &&
-                (p.block_count == -1 || dm.block_count == p.block_count) &&
-                (p.space_count == -1 || dm.space_count == p.space_count)) {
-                single_pattern_match++;
-            }
-        }
-
-        // Consider minimum number of occurrences
-        single_pattern_match /= p.min_occurrence;
-
-        // 取匹配到的局势数量最少的棋谱的匹配次数
-        match_count = match_count >= single_pattern_match ? single_pattern_match : match_count;
-    }
-    return match_count;
+    return countPatternMatches(all_direction_measurement, patterns);
 }
 
 // 测量四个方向的局势
-void RenjuAIEval::measureAllDirections(const char *gs,
+void RenjuAIEval::measureAllDirections(RenjuAISearchContext *ctx,
+                                       const char *gs,
                                        int r,
                                        int c,
                                        int player,
@@ -161,20 +135,186 @@ void RenjuAIEval::measureAllDirections(const char *gs,
                                        RenjuAIEval::DirectionMeasurement *adm) {
     // 检查参数
     if (gs == nullptr) return;
-    if (r < 0 || r >= g_board_size || c < 0 || c >= g_board_size) return;
+    if (r < 0 || r >= ctx->board_size || c < 0 || c >= ctx->board_size) return;
 
     // 测量四个方向的局势：右上、右下、右、下
-    measureDirection(gs, r, c, 0,  1, player, consecutive, &adm[0]);
-    measureDirection(gs, r, c, 1,  1, player, consecutive, &adm[1]);
-    measureDirection(gs, r, c, 1,  0, player, consecutive, &adm[2]);
-    measureDirection(gs, r, c, 1, -1, player, consecutive, &adm[3]);
+    measureDirection(ctx, gs, r, c, 0,  1, player, consecutive, &adm[0]);
+    measureDirection(ctx, gs, r, c, 1,  1, player, consecutive, &adm[1]);
+    measureDirection(ctx, gs, r, c, 1,  0, player, consecutive, &adm[2]);
+    measureDirection(ctx, gs, r, c, 1, -1, player, consecutive, &adm[3]);
+}
+
+// 查表测量四个方向的局势
+void RenjuAIEval::lookupAllDirections(RenjuAISearchContext *ctx,
+                                      const char *gs,
+                                      int r,
+                                      int c,
+                                      int player,
+                                      RenjuAIEval::DirectionMeasurement *adm,
+                                      RenjuAIEval::DirectionMeasurement *adm_consecutive) {
+    // 检查参数
+    if (gs == nullptr) return;
+    int board_size = ctx->board_size;
+    if (r < 0 || r >= board_size || c < 0 || c >= board_size) return;
+
+    const int window_mask = (1 << kRenjuAiEvalLineWindow) - 1;
+    const char *center = gs + board_size * r + c;
+
+    for (int i = 0; i < 4; ++i) {
+        int dr = line_directions[i][0], dc = line_directions[i][1];
+        int own = 0, blocked = 0;
+
+        // 正方向和反方向各编码kRenjuAiEvalLineWindow格，出界的格子当作阻挡
+        for (int side = 0; side < 2; ++side) {
+            int sr = side == 0 ? dr : -dr, sc = side == 0 ? dc : -dc;
+            int steps = kRenjuAiEvalLineWindow;
+            if (sr > 0) steps = std::min(steps, board_size - 1 - r);
+            if (sr < 0) steps = std::min(steps, r);
+            if (sc > 0) steps = std::min(steps, board_size - 1 - c);
+            if (sc < 0) steps = std::min(steps, c);
+
+            int shift = side * kRenjuAiEvalLineWindow;
+            int offset = board_size * sr + sc;
+            const char *p = center;
+            for (int k = 0; k < steps; ++k) {
+                p += offset;
+                int cell = *p;
+                own |= (cell == player) << (shift + k);
+                blocked |= (cell != 0 && cell != player) << (shift + k);
+            }
+            blocked |= (window_mask & ~((1 << steps) - 1)) << shift;
+        }
+
+        decodeLineEntry(ctx, gs, r, c, i, player, own, blocked, &adm[i], &adm_consecutive[i]);
+    }
+}
+
+// 从位棋盘取出窗口，查表测量四个方向的局势
+void RenjuAIEval::lookupAllDirections(RenjuAISearchContext *ctx,
+                                      const RenjuAIBoard &board,
+                                      int r,
+                                      int c,
+                                      int player,
+                                      RenjuAIEval::DirectionMeasurement *adm,
+                                      RenjuAIEval::DirectionMeasurement *adm_consecutive) {
+    for (int i = 0; i < 4; ++i) {
+        int own, blocked;
+        board.lineWindow(i, r, c, player, &own, &blocked);
+        decodeLineEntry(ctx, board.data(), r, c, i, player, own, blocked, &adm[i], &adm_consecutive[i]);
+    }
+}
+
+// 按窗口的位图查局势表，得到一个方向上不连续和连续的测量结果
+void RenjuAIEval::decodeLineEntry(RenjuAISearchContext *ctx,
+                                  const char *gs,
+                                  int r, int c,
+                                  int direction,
+                                  int player,
+                                  int own, int blocked,
+                                  RenjuAIEval::DirectionMeasurement *dm,
+                                  RenjuAIEval::DirectionMeasurement *dm_consecutive) {
+    uint16_t entry = line_table[line_table_base3[own] + 2 * line_table_base3[blocked]];
+    int dr = line_directions[direction][0], dc = line_directions[direction][1];
+
+    // 少数局势需要窗口以外的格子，逐格测量
+    if (entry & (1 << 12)) {
+        measureDirection(ctx, gs, r, c, dr, dc, player, false, dm);
+    } else {
+        dm->length      = entry & 7;
+        dm->block_count = (entry >> 3) & 3;
+        dm->space_count = (entry >> 5) & 1;
+    }
+    if (entry & (1 << 13)) {
+        measureDirection(ctx, gs, r, c, dr, dc, player, true, dm_consecutive);
+    } else {
+        dm_consecutive->length      = (entry >> 6) & 7;
+        dm_consecutive->block_count = (entry >> 9) & 3;
+        dm_consecutive->space_count = (entry >> 11) & 1;
+    }
+}
+
+// 生成局势表
+bool RenjuAIEval::initLineTable() {
+    const int window_cells = 2 * kRenjuAiEvalLineWindow;
+    for (int bits = 0; bits < (1 << window_cells); ++bits) {
+        int value = 0;
+        for (int k = window_cells - 1; k >= 0; --k) value = value * 3 + ((bits >> k) & 1);
+        line_table_base3[bits] = static_cast<uint16_t>(value);
+    }
+
+    for (int index = 0; index < kRenjuAiEvalLineTableSize; ++index) {
+        // 把编码还原成窗口，窗口下标kRenjuAiEvalLineWindow是落子点
+        char window[2 * kRenjuAiEvalLineWindow + 1];
+        window[kRenjuAiEvalLineWindow] = 1;
+        int code = index;
+        for (int k = 0; k < window_cells; ++k, code /= 3) {
+            int distance = k % kRenjuAiEvalLineWindow + 1;
+            int pos = k < kRenjuAiEvalLineWindow ? kRenjuAiEvalLineWindow + distance
+                                                 : kRenjuAiEvalLineWindow - distance;
+            window[pos] = static_cast<char>(code % 3);
+        }
+
+        uint16_t entry = 0;
+        for (int consecutive = 0; consecutive < 2; ++consecutive) {
+            DirectionMeasurement dm;
+            if (measureWindow(window, consecutive != 0, &dm)) {
+                entry |= (dm.length | dm.block_count << 3 | dm.space_count << 5) << (6 * consecutive);
+            } else {
+                entry |= 1 << (12 + consecutive);
+            }
+        }
+        line_table[index] = entry;
+    }
+    return true;
+}
+
+// 在窗口内按measureDirection的规则测量局势
+bool RenjuAIEval::measureWindow(const char *window, bool consecutive, RenjuAIEval::DirectionMeasurement *result) {
+    const int last = 2 * kRenjuAiEvalLineWindow;
+    result->length = 1, result->block_count = 2, result->space_count = 0;
+
+    int space_allowance = consecutive ? 0 : 1;
+    for (int d = 1; d >= -1; d -= 2) {
+        int pos = kRenjuAiEvalLineWindow;
+        while (true) {
+            pos += d;
+            if (pos < 0 || pos > last) return false;
+
+            int cell = window[pos];
+            if (cell == 0) {
+                if (space_allowance > 0) {
+                    if (pos + d < 0 || pos + d > last) return false;
+                    if (window[pos + d] == 1) {
+                        space_allowance--; result->space_count++;
+                        continue;
+                    }
+                }
+                result->block_count--;
+                break;
+            }
+            if (cell != 1) break;
+            result->length++;
+        }
+    }
+
+    if (result->length >= 5) {
+        if (result->space_count == 0) {
+            result->length = 5;
+            result->block_count = 0;
+        } else {
+            result->length = 4;
+            result->block_count = 1;
+        }
+    }
+    return true;
 }
 
 // 测量某个方向的棋局局势并通过result返回，
 // 一个方向的局势大概是某个方向己方棋子一条连起来的情况，
 // 如果consecutive为true则必须是连续的己方棋子，否则可以空一格，但不能是对方棋子。
 // 本方法就是尝试向某个方向延伸，看指定方向“一条”的棋子的数量，以及检测有没有对方棋子堵在“一条”的两端
-void RenjuAIEval::measureDirection(const char *gs,
+void RenjuAIEval::measureDirection(RenjuAISearchContext *ctx,
+                                   const char *gs,
                                    int r, int c,
                                    int dr, int dc,
                                    int player,
@@ -182,7 +322,9 @@ void RenjuAIEval::measureDirection(const char *gs,
                                    RenjuAIEval::DirectionMeasurement *result) {
     // 检查参数
     if (gs == nullptr) return;
-    if (r < 0 || r >= g_board_size || c < 0 || c >= g_board_size) return;
+    BLUPIG_STATS_COUNT(kRenjuStatsMeasureDirection);
+    int board_size = ctx->board_size;
+    if (r < 0 || r >= board_size || c < 0 || c >= board_size) return;
     if (dr == 0 && dc == 0) return;
 
     // 初始化参数，局势的“两头堵”先设置为都被堵，再根据延伸的情况减少
@@ -198,16 +340,16 @@ void RenjuAIEval::measureDirection(const char *gs,
             cr += dr; cc += dc;
 
             // 检测方向是否有效
-            if (cr < 0 || cr >= g_board_size || cc < 0 || cc >= g_board_size) break;
+            if (cr < 0 || cr >= board_size || cc < 0 || cc >= board_size) break;
 
             // 获取延伸的格子的下棋情况
-            int cell = gs[g_board_size * cr + cc];
+            int cell = gs[board_size * cr + cc];
 
             // 如果延伸的格子没有被下，就看看是否要求连续
             if (cell == 0) {
                 // 如果space_allowance大于0，即允许一定数量的空格（不连续），则此次延伸合法
                 // 但是允许空格的数量要减1
-                if (space_allowance > 0 && RenjuAIUtils::getCell(gs, cr + dr, cc + dc) == player) {
+                if (space_allowance > 0 && RenjuAIUtils::getCell(gs, board_size, cr + dr, cc + dc) == player) {
                     space_allowance--; result->space_count++;
                     continue;
                 // 如果要求连续，则这个延伸不合法，本次延伸结束
@@ -243,73 +385,18 @@ void RenjuAIEval::measureDirection(const char *gs,
     }
 }
 
-// 在内存中生成棋谱
-void RenjuAIEval::generatePresetPatterns(DirectionPattern **preset_patterns,
-                                         int **preset_scores,
-                                         int *preset_patterns_size,
-                                         int *preset_patterns_skip) {
-    const int _size = 11;
-    preset_patterns_skip[5] = 0;
-    preset_patterns_skip[4] = 1;
-    preset_patterns_skip[3] = 7;
-    preset_patterns_skip[2] = 10;
-
-    preset_patterns_skip[1] = _size;
-    preset_patterns_skip[0] = _size;
-
-    DirectionPattern patterns[_size * 2] = {
-        {1, 5,  0,  0}, {0, 0,  0,  0},  // 10000
-        {1, 4,  0,  0}, {0, 0,  0,  0},  // 700
-        {2, 4,  1,  0}, {0, 0,  0,  0},  // 700
-        {2, 4, -1,  1}, {0, 0,  0,  0},  // 700
-        {1, 4,  1,  0}, {1, 4, -1,  1},  // 700
-        {1, 4,  1,  0}, {1, 3,  0, -1},  // 500
-        {1, 4, -1,  1}, {1, 3,  0, -1},  // 500
-        {2, 3,  0, -1}, {0, 0,  0,  0},  // 300
-        // {1, 4,  1,  0}, {0, 0,  0,  0},  // 1
-        // {1, 4, -1,  1}, {0, 0,  0,  0},  // 1
-        {3, 2,  0, -1}, {0, 0,  0,  0},  // 50
-        {1, 3,  0, -1}, {0, 0,  0,  0},  // 20
-        {1, 2,  0, -1}, {0, 0,  0,  0}   // 9
-    };
-
-    int scores[_size] = {
-        10000,
-        700,
-        700,
-        700,
-        700,
-        500,
-        500,
-        300,
-        // 1,
-        // 1,
-        50,
-        20,
-        9
-    };
-
-    *preset_patterns = new DirectionPattern[_size * 2];
-    *preset_scores   = new int[_size];
-
-    memcpy(*preset_patterns, patterns, sizeof(DirectionPattern) * _size * 2);
-    memcpy(*preset_scores, scores, sizeof(int) * _size);
-
-    *preset_patterns_size = _size;
-}
-
 // 检查是否有棋手获胜
-int RenjuAIEval::winningPlayer(const char *gs) {
+int RenjuAIEval::winningPlayer(RenjuAISearchContext *ctx, const char *gs) {
     if (gs == nullptr) return 0;
-    for (int r = 0; r < g_board_size; ++r) {
-        for (int c = 0; c < g_board_size; ++c) {
-            int cell = gs[g_board_size * r + c];
+    for (int r = 0; r < ctx->board_size; ++r) {
+        for (int c = 0; c < ctx->board_size; ++c) {
+            int cell = gs[ctx->board_size * r + c];
             if (cell == 0) continue;
             for (int dr = -1; dr <= 1; ++dr) {
                 for (int dc = -1; dc <= 1; ++dc) {
                     if (dr == 0 && dc <= 0) continue;
                     DirectionMeasurement dm;
-                    measureDirection(gs, r, c, dr, dc, cell, 1, &dm);
+                    measureDirection(ctx, gs, r, c, dr, dc, cell, 1, &dm);
                     if (dm.length >= 5) return cell;
                 }
             }
@@ -19,23 +19,33 @@
 #include <ai/negamax.h>
 #include <ai/eval.h>
 #include <ai/utils.h>
-#include <utils/globals.h>
+#include <utils/stats.h>
 #include <algorithm>
 #include <climits>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 // 对于不同搜索深度，本层允许的宽度不一样。
 // 对于较浅的层级，搜索宽度较大，反之较小
 int RenjuAINegamax::presetSearchBreadth[5] = {17, 7, 5, 3, 3};
 
-// 迭代加深时评估分支数，用于预估搜索时间
-#define kAvgBranchingFactor 3
-
-// 最大搜索深度
-#define kMaximumDepth 16
+// 进程共享的置换表，默认大小为kRenjuAiTTDefaultSizeMB，第一次搜索时分配
+RenjuAITranspositionTable RenjuAINegamax::transposition_table;
+int RenjuAINegamax::transposition_table_size = kRenjuAiTTDefaultSizeMB;
+int RenjuAINegamax::transposition_table_users = 0;
+std::mutex RenjuAINegamax::transposition_table_mutex;
+
+// 本线程用掉的CPU时间（微秒）
+static uint64_t threadCpuTime() {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000000 + static_cast<uint64_t>(t.tv_nsec) / 1000;
+}
 
 // 定义每层的分数的“衰减比例”，详情请看调用了此define的代码
 #define kScoreDecayFactor 0.95f
@@ -43,33 +53,70 @@ int RenjuAINegamax::presetSearchBreadth[5] = {17, 7, 5, 3, 3};
 // 提供给外部调用的启发式Nagamax算法
 // 
 // 参数：
+// ctx：搜索上下文，提供棋盘尺寸和时间预算（time_limit），并记录计数器
 // gs：游戏状态，即当前下了子的棋盘。可以看作是行优先存储的棋盘
 // player：程序的使用的棋子颜色
 // depth：搜索深度
-// time_limit：搜索时间限制
 // enable_ab_pruning：是否启用alpha-beta剪枝
 // actual_depth：回传实际的搜索深度
 // move_r：计算出的下一步应下棋子的行
 // move_c：计算出的下一步应下的棋子的列
-void RenjuAINegamax::heuristicNegamax(const char *gs, int player, int depth, int time_limit, bool enable_ab_pruning,
-                                      int *actual_depth, int *move_r, int *move_c) {
+// num_threads：搜索线程数，多于1个时启动Lazy SMP辅助线程，结果仍以本线程为准
+void RenjuAINegamax::heuristicNegamax(RenjuAISearchContext *ctx, const char *gs, int player, int depth,
+                                      bool enable_ab_pruning, int *actual_depth, int *move_r, int *move_c,
+                                      int num_threads) {
+    if (ctx == nullptr || gs == nullptr ||
+        ctx->board_size < 1 || ctx->board_size > kRenjuAiMaxBoardSize) return;
+
+    //载入当前游戏状态到上下文的棋盘，搜索时在它上面下棋和悔棋，哈希值和启发值缓存随之增量更新
+    ctx->board.load(gs);
+    search(ctx, player, depth, enable_ab_pruning, actual_depth, move_r, move_c, num_threads);
+}
+
+// 在ctx->board的当前局面上搜索，参数同上
+// 每次搜索结束后棋盘都会还原，启发值缓存在迭代加深的各次迭代间、以及同一棋盘的多次搜索间保留
+void RenjuAINegamax::search(RenjuAISearchContext *ctx, int player, int depth, bool enable_ab_pruning,
+                            int *actual_depth, int *move_r, int *move_c, int num_threads) {
     // Check arguments
-    if (gs == nullptr ||
+    if (ctx == nullptr ||
+        ctx->board_size < 1 || ctx->board_size > kRenjuAiMaxBoardSize ||
         player < 1 || player > 2 ||
         depth == 0 || depth < -1 ||
-        time_limit < 0) return;
+        ctx->time_limit < 0 || num_threads < 1) return;
+
+    BLUPIG_STATS_TIMER(kRenjuStatsTimerSearch);
+    uint64_t cpu_begin = threadCpuTime();
 
-    //备份当前游戏状态，即棋盘，因为每次调用另一签名的heuristicNegamax方法都会改写_gs
-    char *_gs = new char[g_gs_size];
-    memcpy(_gs, gs, g_gs_size);
+    // 没有指定置换表时使用进程共享的置换表，搜索结束前它的大小不能改变
+    SharedTableUse shared_table_use(ctx);
+    if (ctx->transposition_table == nullptr) ctx->transposition_table = sharedTranspositionTable();
 
     // 程序默认是使用迭代加深的搜索策略，但如果棋局刚开始，
     // 可以直接设置一个深度进行搜索以加快速度，这里深度为6
-    int _cnt = 0;
-    for (int i = 0; i < static_cast<int>(g_gs_size); i++)
-        if (_gs[i] != 0) _cnt++;
-
-    if (_cnt <= 2) depth = 6;
+    if (ctx->board.stoneCount() <= 2) depth = 6;
+
+    // 下法列表只预先分配了kRenjuAiMaxSearchDepth层
+    if (depth > kRenjuAiMaxSearchDepth) depth = kRenjuAiMaxSearchDepth;
+
+    // 只有迭代加深受时间预算限制，指定深度的搜索总是完整地进行
+    // 有结点数预算时不看时间
+    ctx->aborted = false;
+    ctx->iterations.clear();
+    if (depth < 0 && ctx->node_limit == 0) ctx->timer.start(ctx->time_limit);
+    else                                   ctx->timer.startUnlimited();
+
+    // 启动辅助线程，它们使用各自的上下文，只通过置换表影响本线程的搜索
+    // 搜索时本线程会改动棋盘，所以辅助线程从棋盘的副本载入
+    std::vector<char> helper_gs(ctx->board.data(), ctx->board.data() + ctx->gs_size);
+    std::atomic<bool> helpers_stop(false);
+    std::vector<std::thread> helpers;
+    std::vector<RenjuAISearchContext> helper_ctxs(num_threads - 1, RenjuAISearchContext(ctx->board_size));
+    for (int i = 1; i < num_threads; ++i) {
+        RenjuAISearchContext *helper_ctx = &helper_ctxs[i - 1];
+        helper_ctx->stop = &helpers_stop;
+        helper_ctx->transposition_table = ctx->transposition_table;
+        helpers.emplace_back(helperSearch, helper_ctx, helper_gs.data(), player, depth, enable_ab_pruning, i);
+    }
 
     //根据逐层调用发现，depth传入时是-1，
     //意味着如果depth是-1，即使用迭代加深的搜索策略
@@ -78,45 +125,176 @@ void RenjuAINegamax::heuristicNegamax(const char *gs, int player, int depth, int
         //设置回传的实际搜索深度
         if (actual_depth != nullptr) *actual_depth = depth;
         //调用核心算法计算下棋位置
-        heuristicNegamax(_gs, player, depth, depth, enable_ab_pruning,
-                         INT_MIN / 2, INT_MAX / 2, move_r, move_c);
+        BLUPIG_STATS_TIMER(kRenjuStatsTimerIteration);
+        IterationCounters start = IterationCounters::of(ctx);
+        int search_r = -1, search_c = -1;
+        int score = heuristicNegamax(ctx, player, depth, depth, enable_ab_pruning,
+                                     INT_MIN / 2, INT_MAX / 2, &search_r, &search_c);
+        if (move_r != nullptr) *move_r = search_r;
+        if (move_c != nullptr) *move_c = search_c;
+        if (!ctx->stopped()) {
+            recordIteration(ctx, start, player, depth, score, search_r, search_c);
+            if (ctx->iteration_callback != nullptr)
+                ctx->iteration_callback(ctx->iteration_callback_data, *ctx, depth, score, search_r, search_c);
+        }
     } else {
-
-        std::clock_t c_start = std::clock();
-        //使用迭代加深的搜索策略，直到搜索时间超过了预设的time_limit，
-        //或搜索深度超过上限kMaximumDepth
+        //使用墙上时间计时，多线程时进程CPU时间会成倍增长
+        //使用迭代加深的搜索策略，过了软期限后不再开始新的迭代，
+        //到达硬期限（time_limit）时正在进行的迭代被中止，
+        //或搜索深度超过上限kRenjuAiMaxSearchDepth
+        int best_r = -1, best_c = -1;
         for (int d = 6;; d += 2) {
-            std::clock_t c_iteration_start = std::clock();
-
-            //搜索前还原上次迭代加深搜索修改的棋局
-            memcpy(_gs, gs, g_gs_size);
+            long long iteration_start = ctx->timer.elapsed();
+            IterationCounters start = IterationCounters::of(ctx);
+            BLUPIG_STATS_TIMER(kRenjuStatsTimerIteration);
 
             //以本次迭代深度d进行启发式Negamax搜索
-            heuristicNegamax(_gs, player, d, d, enable_ab_pruning,
-                             INT_MIN / 2, INT_MAX / 2, move_r, move_c);
-
-            //用于计算是否超时
-            std::clock_t c_iteration = (std::clock() - c_iteration_start) * 1000 / CLOCKS_PER_SEC;
-            std::clock_t c_elapsed = (std::clock() - c_start) * 1000 / CLOCKS_PER_SEC;
+            //较浅的迭代保存在置换表中的结果可以改善本次迭代的搜索顺序
+            int iteration_r = -1, iteration_c = -1;
+            int score = heuristicNegamax(ctx, player, d, d, enable_ab_pruning,
+                                         INT_MIN / 2, INT_MAX / 2, &iteration_r, &iteration_c);
+
+            //本次迭代超时或被停止，结果不完整，使用上一次完成的迭代的结果；
+            //第一次迭代就被中止时，只能使用根结点已经搜索完的下法中最好的
+            if (ctx->stopped()) {
+                if (best_r < 0) {
+                    best_r = iteration_r;
+                    best_c = iteration_c;
+                    if (actual_depth != nullptr) *actual_depth = d;
+                }
+                break;
+            }
+            best_r = iteration_r;
+            best_c = iteration_c;
+            if (actual_depth != nullptr) *actual_depth = d;
+
+            //记录这次迭代的统计，通知调用者这次迭代的结果，回调可能设置停止标志
+            recordIteration(ctx, start, player, d, score, iteration_r, iteration_c);
+            if (ctx->iteration_callback != nullptr) {
+                ctx->iteration_callback(ctx->iteration_callback_data, *ctx, d, score, iteration_r, iteration_c);
+                if (ctx->stopped()) break;
+            }
 
-            //如果搜索时间超过了限制或搜索深度超过了限制则退出
-            if (c_elapsed + (c_iteration * kAvgBranchingFactor * kAvgBranchingFactor) > time_limit ||
-                d >= kMaximumDepth) {
-                if (actual_depth != nullptr) *actual_depth = d;
+            //如果来不及完成下一次迭代或搜索深度超过了限制则退出
+            //有结点数预算时，按这次迭代的结点数估计下一次迭代的结点数
+            if (d >= kRenjuAiMaxSearchDepth) break;
+            if (ctx->node_limit != 0) {
+                uint64_t next_nodes = (ctx->node_count - start.node_count) * kRenjuAiTimeBranchingFactor;
+                if (ctx->node_count + next_nodes > ctx->node_limit) break;
+            } else if (!ctx->timer.shouldStartIteration(ctx->timer.elapsed() - iteration_start)) {
                 break;
             }
         }
+        if (move_r != nullptr) *move_r = best_r;
+        if (move_c != nullptr) *move_c = best_c;
+    }
+
+    // 停止辅助线程，把它们的计数器（包括CPU时间）加到本上下文
+    helpers_stop.store(true, std::memory_order_relaxed);
+    for (int i = 0; i < static_cast<int>(helpers.size()); ++i) {
+        helpers[i].join();
+        ctx->addCounters(helper_ctxs[i]);
+    }
+    ctx->cpu_time += threadCpuTime() - cpu_begin;
+}
+
+void RenjuAINegamax::principalVariation(RenjuAISearchContext *ctx, int player, int move_r, int move_c,
+                                        int max_length, std::vector<RenjuAIMove> *pv) {
+    pv->clear();
+    RenjuAIBoard *board = &ctx->board;
+    RenjuAITranspositionTable *tt = ctx->transposition_table;
+    if (move_r < 0 || move_c < 0 || board->cell(move_r, move_c) != 0) return;
+
+    RenjuAIMove move = {move_r, move_c, 0, 0};
+    for (int p = player; ; p = p == 1 ? 2 : 1) {
+        pv->push_back(move);
+        board->make(move.r, move.c, p);
+
+        // 有人连五或置换表中没有后续下法时结束
+        RenjuAITranspositionTable::Entry tt_entry;
+        int next = p == 1 ? 2 : 1;
+        if (static_cast<int>(pv->size()) >= max_length || board->fiveAt(move.r, move.c, p) ||
+            tt == nullptr || !tt->probe(board->key(next), &tt_entry) ||
+            tt_entry.move_r < 0 || board->cell(tt_entry.move_r, tt_entry.move_c) != 0) break;
+        move.r = tt_entry.move_r;
+        move.c = tt_entry.move_c;
     }
-    delete[] _gs;
+
+    // 还原棋盘
+    for (int i = static_cast<int>(pv->size()) - 1; i >= 0; --i) board->unmake((*pv)[i].r, (*pv)[i].c);
+}
+
+void RenjuAINegamax::recordIteration(RenjuAISearchContext *ctx, const IterationCounters &start, int player,
+                                     int depth, int score, int move_r, int move_c) {
+    ctx->iterations.emplace_back();
+    RenjuAIIterationStats &stats = ctx->iterations.back();
+    uint64_t expanded = ctx->expanded_count - start.expanded_count;
+    uint64_t cutoffs = ctx->cutoff_count - start.cutoff_count;
+    uint64_t tt_probes = ctx->tt_probe_count - start.tt_probe_count;
+
+    stats.depth = depth;
+    stats.elapsed = ctx->timer.elapsed();
+    stats.node_count = ctx->node_count - start.node_count;
+    stats.branching_factor = std::pow(static_cast<double>(stats.node_count), 1.0 / depth);
+    stats.beta_cutoff_rate = expanded > 0 ? static_cast<double>(cutoffs) / expanded : 0;
+    stats.first_move_cutoff_rate =
+        cutoffs > 0 ? static_cast<double>(ctx->first_move_cutoff_count - start.first_move_cutoff_count) / cutoffs : 0;
+    stats.tt_hit_rate = tt_probes > 0 ? static_cast<double>(ctx->tt_hit_count - start.tt_hit_count) / tt_probes : 0;
+    stats.move_r = move_r;
+    stats.move_c = move_c;
+    stats.score = score;
+    principalVariation(ctx, player, move_r, move_c, depth, &stats.pv);
+}
+
+void RenjuAINegamax::helperSearch(RenjuAISearchContext *ctx, const char *gs, int player, int depth,
+                                  bool enable_ab_pruning, int thread_id) {
+    uint64_t cpu_begin = threadCpuTime();
+    ctx->board.load(gs);
+
+    // 奇数号线程比主线程深一次迭代，使各线程搜索的深度错开
+    int d = (depth > 0 ? depth : 6) + 2 * (thread_id & 1);
+    for (; d <= kRenjuAiMaxSearchDepth && !ctx->stopped(); d += 2) {
+        heuristicNegamax(ctx, player, d, d, enable_ab_pruning,
+                         INT_MIN / 2, INT_MAX / 2, nullptr, nullptr);
+    }
+    ctx->cpu_time += threadCpuTime() - cpu_begin;
+}
+
+bool RenjuAINegamax::setTranspositionTableSize(int size_mb) {
+    if (size_mb < 0) return false;
+    std::lock_guard<std::mutex> lock(transposition_table_mutex);
+    if (transposition_table_users > 0) return false;
+    transposition_table_size = size_mb;
+    transposition_table.resize(size_mb);
+    return true;
 }
 
+RenjuAITranspositionTable *RenjuAINegamax::sharedTranspositionTable() {
+    std::lock_guard<std::mutex> lock(transposition_table_mutex);
+    if (!transposition_table.enabled() && transposition_table_size > 0)
+        transposition_table.resize(transposition_table_size);
+    return &transposition_table;
+}
 
+RenjuAINegamax::SharedTableUse::SharedTableUse(const RenjuAISearchContext *ctx) :
+    registered(ctx == nullptr ||
+               ctx->transposition_table == nullptr || ctx->transposition_table == &transposition_table) {
+    if (!registered) return;
+    std::lock_guard<std::mutex> lock(transposition_table_mutex);
+    transposition_table_users++;
+}
+
+RenjuAINegamax::SharedTableUse::~SharedTableUse() {
+    if (!registered) return;
+    std::lock_guard<std::mutex> lock(transposition_table_mutex);
+    transposition_table_users--;
+}
 
 // 核心算法，用于进行搜索。该方法递归调用，传入指定的搜索深度
 // 
 // 参数：
 // 
-// gs：游戏状态
+// ctx：搜索上下文，ctx->board是搜索时修改的游戏状态，同时维护哈希值和启发值缓存
 // player：程序使用的棋子颜色
 // initial_depth：初始深度
 // depth：本次调用的深度
@@ -125,32 +303,87 @@ void RenjuAINegamax::heuristicNegamax(const char *gs, int player, int depth, int
 // beta：beta的值
 // move_r：计算出的下一步应下棋子的行
 // move_c：计算出的下一步应下的棋子的列
-int RenjuAINegamax::heuristicNegamax(char *gs, int player, int initial_depth, int depth,
+int RenjuAINegamax::heuristicNegamax(RenjuAISearchContext *ctx, int player, int initial_depth, int depth,
                                      bool enable_ab_pruning, int alpha, int beta,
                                      int *move_r, int *move_c) {
-    // 全局生成结点数目增1
-    ++g_node_count;
+    // 生成结点数目增1
+    ++ctx->node_count;
+    BLUPIG_STATS_COUNT(kRenjuStatsNode);
+
+    // 搜索超时或被停止，结果不再使用
+    // 根结点不检查时间，保证每次迭代至少生成根结点的候选下法
+    if (depth != initial_depth) ctx->pollTime();
+    if (ctx->stopped()) return 0;
+
+    RenjuAIBoard *board = &ctx->board;
+
+    // 同一棋盘轮到不同的人下棋是不同的局面
+    uint64_t key = board->key(player);
+
+    // 查找置换表。搜索宽度随到根结点的距离变化，所以只有初始深度和剩余深度都相同（搜索的形状相同）时，
+    // 非根结点才能直接使用保存的分数，否则只用保存的最佳下法改善搜索顺序
+    // 不剪枝的搜索用于验证结果，不使用置换表
+    RenjuAITranspositionTable *tt = ctx->transposition_table;
+    bool use_tt = enable_ab_pruning && tt != nullptr && tt->enabled();
+    RenjuAITranspositionTable::Entry tt_entry;
+    bool tt_hit = use_tt && tt->probe(key, &tt_entry);
+    if (use_tt) {
+        ++ctx->tt_probe_count;
+        BLUPIG_STATS_COUNT(kRenjuStatsTTProbe);
+        if (tt_hit) {
+            ++ctx->tt_hit_count;
+            BLUPIG_STATS_COUNT(kRenjuStatsTTHit);
+        }
+    }
+    if (tt_hit && depth != initial_depth && tt_entry.initial_depth == initial_depth && tt_entry.depth == depth) {
+        int tt_score = tt_entry.score;
+        int tt_score_decayed = tt_score;
+        if (tt_score >= 2) tt_score_decayed = static_cast<int>(tt_score * kScoreDecayFactor);
+
+        if (tt_entry.bound == RenjuAITranspositionTable::kBoundExact) return tt_score;
+        if (tt_entry.bound == RenjuAITranspositionTable::kBoundLower && tt_score_decayed >= beta) return tt_score;
+        if (tt_entry.bound == RenjuAITranspositionTable::kBoundUpper && tt_score <= alpha) return tt_score;
+    }
+    int alpha_original = alpha;
 
     // 保存当前最高分数的走法
     int max_score = INT_MIN;
     // opponent是玩家
     int opponent = player == 1 ? 2 : 1;
 
+    // 根据深度设置搜索宽度，成负相关
+    // 随着本方法被递归调用，搜索宽度会逐渐增大
+    int breadth = (initial_depth >> 1) - ((depth + 1) >> 1);
+    if (breadth > 4) breadth = presetSearchBreadth[4];
+    else             breadth = presetSearchBreadth[breadth];
+
     // 针对AI和玩家生成所有可走的位置，并按位置的启发值排序
     // candidate_moves的走法进行深度搜索，所以candidate_moves就是当前深度的可扩展结点
-    std::vector<Move> moves_player, moves_opponent, candidate_moves;
-    searchMovesOrdered(gs, player, &moves_player);
-    searchMovesOrdered(gs, opponent, &moves_opponent);
+    // 己方只会搜索启发值最高的breadth个下法，对方只会用到最高的两个，所以不需要完整排序
+    // 列表使用上下文中为本层预先分配的缓冲区
+    RenjuAISearchPly &ply = ctx->plies[initial_depth - depth];
+    RenjuAIMoveList &moves_player = ply.moves_player;
+    RenjuAIMoveList &moves_opponent = ply.moves_opponent;
+    RenjuAIMoveList &candidate_moves = ply.candidate_moves;
+    candidate_moves.clear();
+    int player_move_count = searchMovesOrdered(ctx, player, &moves_player, breadth);
+    searchMovesOrdered(ctx, opponent, &moves_opponent, 2);
 
     // 如果AI无棋可走则退出
-    if (moves_player.size() == 0) return 0;
+    if (player_move_count == 0) {
+        if (use_tt) tt->store(key, initial_depth, depth, RenjuAITranspositionTable::kBoundExact, 0, -1, -1);
+        return 0;
+    }
 
     // 如果AI只有一个位置可走，或者有“绝招”可走，就走这一步然后直接退出
-    // 绝招是指启发值超过指定限制的，即超过kRenjuAiEvalWinningScore，下绝招位置胜率会大大提升
-    if (moves_player.size() == 1 || moves_player[0].heuristic_val >= kRenjuAiEvalWinningScore) {
+    // 绝招是指下了就连成五个的位置，它的启发值最高，一定排在最前面
+    // 直接在位棋盘上检查这一步是否连五，不依赖启发值的阈值
+    if (player_move_count == 1 || board->fiveAt(moves_player[0].r, moves_player[0].c, player)) {
         auto move = moves_player[0];
         if (move_r != nullptr) *move_r = move.r;
         if (move_c != nullptr) *move_c = move.c;
+        if (use_tt) tt->store(key, initial_depth, depth, RenjuAITranspositionTable::kBoundExact,
+                              move.heuristic_val, move.r, move.c);
         return move.heuristic_val;
     }
 
@@ -158,31 +391,39 @@ int RenjuAINegamax::heuristicNegamax(char *gs, int player, int initial_depth, in
 
     // 用于标记是否该步是用来堵绝招
     bool block_opponent = false;
-    int tmp_size = std::min(static_cast<int>(moves_opponent.size()), 2);
+    int tmp_size = std::min(moves_opponent.size(), 2);
     if (moves_opponent[0].heuristic_val >= kRenjuAiEvalThreateningScore) {
         block_opponent = true;
         for (int i = 0; i < tmp_size; ++i) {
             auto move = moves_opponent[i];
 
             // 堵住绝招后重新评估该步的启发值
-            move.heuristic_val = RenjuAIEval::evalMove(gs, move.r, move.c, player);
+            move.heuristic_val = board->heuristic(ctx, move.r, move.c, player);
 
             // 将“堵绝招”走法加入候选走法之一
             candidate_moves.push_back(move);
         }
     }
 
-    // 根据深度设置搜索宽度，成负相关
-    // 随着本方法被递归调用，搜索宽度会逐渐增大
-    int breadth = (initial_depth >> 1) - ((depth + 1) >> 1);
-    if (breadth > 4) breadth = presetSearchBreadth[4];
-    else             breadth = presetSearchBreadth[breadth];
-
     // 按照breadth设定的值，添加breadth个启发值最大的走法到候选走法内（即要进行深度搜索的走法）
-    tmp_size = std::min(static_cast<int>(moves_player.size()), breadth);
+    int blocking_size = candidate_moves.size();
+    tmp_size = std::min(moves_player.size(), breadth);
     for (int i = 0; i < tmp_size; ++i)
         candidate_moves.push_back(moves_player[i]);
 
+    // 置换表中保存的最佳下法最先搜索，更容易剪枝
+    // 堵绝招的走法仍然在最前面，因为根结点会用到candidate_moves[0]
+    if (tt_hit && tt_entry.move_r >= 0) {
+        for (int i = blocking_size; i < candidate_moves.size(); ++i) {
+            if (candidate_moves[i].r == tt_entry.move_r && candidate_moves[i].c == tt_entry.move_c) {
+                std::rotate(candidate_moves.begin() + blocking_size,
+                            candidate_moves.begin() + i,
+                            candidate_moves.begin() + i + 1);
+                break;
+            }
+        }
+    }
+
       // Print heuristic values for debugging
 //    if (depth >= 8) {
 //        for (int i = 0; i < moves_player.size(); ++i) {
@@ -191,17 +432,26 @@ int RenjuAINegamax::heuristicNegamax(char *gs, int player, int initial_depth, in
 //        }
 //    }
 
+    // 根结点先给出启发值最高（或堵绝招）的下法，搜索中途被中止时至少有一个可用的结果
+    if (depth == initial_depth) {
+        if (move_r != nullptr) *move_r = candidate_moves[0].r;
+        if (move_c != nullptr) *move_c = candidate_moves[0].c;
+    }
+
     // 对每个走法再进行启发式Negamax搜索
-    int size = static_cast<int>(candidate_moves.size());
+    ++ctx->expanded_count;
+    int best_r = -1, best_c = -1;
+    bool pruned = false;
+    int size = candidate_moves.size();
     for (int i = 0; i < size; ++i) {
         auto move = candidate_moves[i];
 
-        // 尝试下棋，修改棋盘状态
-        RenjuAIUtils::setCell(gs, move.r, move.c, static_cast<char>(player));
+        // 尝试下棋，修改棋盘状态，同时更新哈希值和启发值缓存
+        board->make(move.r, move.c, player);
 
         // 递归调用启发式Negamax算法进行深度搜索
         int score = 0;
-        if (depth > 1) score = heuristicNegamax(gs,                 // 游戏状态
+        if (depth > 1) score = heuristicNegamax(ctx,                // 搜索上下文，包含游戏状态
                                                 opponent,           // 更换下棋的人，由对方下棋，即更换max和min方
                                                 initial_depth,      // 最初设定的深度
                                                 depth - 1,          // 当前深度
@@ -228,11 +478,16 @@ int RenjuAINegamax::heuristicNegamax(char *gs, int player, int initial_depth, in
 //            std::cout << depth << " | " << move.r << ", " << move.c << ": " << move.actual_score << std::endl;
 
         // 恢复棋盘到搜索前的状态
-        RenjuAIUtils::setCell(gs, move.r, move.c, 0);
+        board->unmake(move.r, move.c);
+
+        // 下层搜索被中止，分数无效，也不能写入置换表
+        if (ctx->stopped()) return 0;
 
         // 更新本层宽度搜索得分最大值，试图寻找最大值
         if (move.actual_score > max_score) {
             max_score = move.actual_score;
+            best_r = move.r;
+            best_c = move.c;
             if (move_r != nullptr) *move_r = move.r;
             if (move_c != nullptr) *move_c = move.c;
         }
@@ -242,7 +497,13 @@ int RenjuAINegamax::heuristicNegamax(char *gs, int player, int initial_depth, in
         if (max_score > alpha) alpha = max_score;
 
         // 剪枝
-        if (enable_ab_pruning && max_score_decayed >= beta) break;
+        if (enable_ab_pruning && max_score_decayed >= beta) {
+            pruned = true;
+            ++ctx->cutoff_count;
+            BLUPIG_STATS_COUNT(kRenjuStatsBetaCutoff);
+            if (i == 0) ++ctx->first_move_cutoff_count;
+            break;
+        }
     }
 
     // 如果本层是最浅层，就要考虑是否堵住对方的“绝招”
@@ -251,97 +512,98 @@ int RenjuAINegamax::heuristicNegamax(char *gs, int player, int initial_depth, in
         int b_score = blocking_move.actual_score;
         if (b_score == 0) b_score = 1;
         if ((max_score - b_score) / static_cast<float>(std::abs(b_score)) < 0.2) {
+            best_r = blocking_move.r;
+            best_c = blocking_move.c;
             if (move_r != nullptr) *move_r = blocking_move.r;
             if (move_c != nullptr) *move_c = blocking_move.c;
             max_score = blocking_move.actual_score;
         }
     }
+
+    // 保存到置换表：剪枝时分数是下界，没有超过alpha时分数是上界
+    if (use_tt) {
+        int bound = RenjuAITranspositionTable::kBoundExact;
+        if (pruned) bound = RenjuAITranspositionTable::kBoundLower;
+        else if (max_score <= alpha_original) bound = RenjuAITranspositionTable::kBoundUpper;
+        tt->store(key, initial_depth, depth, bound, max_score, best_r, best_c);
+    }
     return max_score;
 }
 
 // 这个函数会尝试在棋盘上所有可以下的位置都放置一个棋子，然后评估每个棋子的启发值。
-// 在具体实现时，为了避免搜索范围过大，会将搜索区域收缩到当前已经放置了棋子的矩形区域附近
-void RenjuAINegamax::searchMovesOrdered(const char *gs, int player, std::vector<Move> *result) {
+// 为了避免搜索范围过大，只考虑周围两格内有棋子的空格，也就是不会无端地把棋子下在远离棋子集中区域的地方
+// 这些候选位置由棋盘在下棋和悔棋时增量维护，这里只需按行优先的顺序逐个取出
+int RenjuAINegamax::searchMovesOrdered(RenjuAISearchContext *ctx, int player, RenjuAIMoveList *result, int limit) {
+    BLUPIG_STATS_COUNT(kRenjuStatsMoveGen);
+    BLUPIG_STATS_TIMER(kRenjuStatsTimerMoveGen);
+    RenjuAIBoard *board = &ctx->board;
+    if (limit < 0) limit = kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize;
+
     // 清除结果
     result->clear();
 
-    //这个过程就是收缩搜索区域，会生成一个矩形区域，我们称之为“含子区域”
-    int min_r = INT_MAX, min_c = INT_MAX, max_r = INT_MIN, max_c = INT_MIN;
-    for (int r = 0; r < g_board_size; ++r) {
-        for (int c = 0; c < g_board_size; ++c) {
-            if (gs[g_board_size * r + c] != 0) {
-                if (r < min_r) min_r = r;
-                if (c < min_c) min_c = c;
-                if (r > max_r) max_r = r;
-                if (c > max_c) max_c = c;
-            }
-        }
-    }
-
-    // 因为“含子区域”是紧贴当前已含棋子区域的，但“尝试放置”的区域会比“含子区域”稍宽（看下面的代码）
-    // 所以为了避免下面“尝试放置”时放出了搜索范围，会提前再次收缩“含子区域”，
-    // 由此得到的区域我们称之为“兼容的尝试放置区域”
-    if (min_r - 2 < 0) min_r = 2;
-    if (min_c - 2 < 0) min_c = 2;
-    if (max_r + 2 >= g_board_size) max_r = g_board_size - 3;
-    if (max_c + 2 >= g_board_size) max_c = g_board_size - 3;
-
-
-    // 搜索整个“尝试放置区域”，这个范围是由“兼容的尝试放置区域”每边向外扩展两格得到的
-    for (int r = min_r - 2; r <= max_r + 2; ++r) {
-        for (int c = min_c - 2; c <= max_c + 2; ++c) {
-
-            // 已经下了棋子的区域就不尝试放置了
-            if (gs[g_board_size * r + c] != 0) continue;
-
-            // 如果这个位置是一个远离当前“棋子团”的下棋位置，就不评估它了，直接跳过。
-            // 也就是说程序不会无端地把棋子下在远离棋子集中区域的地方
-            if (RenjuAIUtils::remoteCell(gs, r, c)) continue;
-
-            Move m;
+    int count = 0;
+    for (int r = 0; r < ctx->board_size; ++r) {
+        for (uint32_t row = board->candidateRow(r); row != 0; row &= row - 1) {
+            RenjuAIMove m;
             m.r = r;
-            m.c = c;
+            m.c = __builtin_ctz(row);
 
             // 调用启发式评估函数评估这个走法的启发值
-            m.heuristic_val = RenjuAIEval::evalMove(gs, r, c, player);
-
-            // 添加走法
-            result->push_back(m);
+            m.heuristic_val = board->heuristic(ctx, m.r, m.c, player);
+            ++count;
+
+            // 插入到按启发值从大到小排列的结果中，已满时只有比最后一个好的下法才会挤掉它
+            // 只有启发值更高才往前移，所以启发值相同的下法保持行优先的顺序
+            int i;
+            if (result->size() < limit) {
+                result->push_back(m);
+                i = result->size() - 1;
+            } else if (m < (*result)[limit - 1]) {
+                i = limit - 1;
+            } else {
+                continue;
+            }
+            for (; i > 0 && m < (*result)[i - 1]; --i) (*result)[i] = (*result)[i - 1];
+            (*result)[i] = m;
         }
     }
-    //按启发值从大到小排序（通过Move类型重载的<运算符进行）
-    std::sort(result->begin(), result->end());
+    BLUPIG_STATS_ADD(kRenjuStatsMoveGenCandidates, count);
+    return count;
 }
 
 // 这个方法在整个项目中没有调用
-int RenjuAINegamax::negamax(char *gs, int player, int depth, int *move_r, int *move_c) {
+int RenjuAINegamax::negamax(RenjuAISearchContext *ctx, char *gs, int player, int depth, int *move_r, int *move_c) {
+    int board_size = ctx->board_size;
+
     // Initialize with a minimum score
     int max_score = INT_MIN;
 
     // Eval game state
-    if (depth == 0) return RenjuAIEval::evalState(gs, player);
+    if (depth == 0) return RenjuAIEval::evalState(ctx, gs, player);
 
     // Loop through all cells
-    for (int r = 0; r < g_board_size; ++r) {
-        for (int c = 0; c < g_board_size; ++c) {
+    for (int r = 0; r < board_size; ++r) {
+        for (int c = 0; c < board_size; ++c) {
             // Consider only empty cells
-            if (RenjuAIUtils::getCell(gs, r, c) != 0) continue;
+            if (RenjuAIUtils::getCell(gs, board_size, r, c) != 0) continue;
 
             // Skip remote cells (no pieces within 2 cells)
-            if (RenjuAIUtils::remoteCell(gs, r, c)) continue;
+            if (RenjuAIUtils::remoteCell(gs, board_size, r, c)) continue;
 
             // Execute move
-            RenjuAIUtils::setCell(gs, r, c, static_cast<char>(player));
+            RenjuAIUtils::setCell(gs, board_size, r, c, static_cast<char>(player));
 
             // Run negamax recursively
-            int s = -negamax(gs,                   // Game state
+            int s = -negamax(ctx,                  // Search context
+                             gs,                   // Game state
                              player == 1 ? 2 : 1,  // Change player
                              depth - 1,            // Reduce depth by 1
                              nullptr,              // Result move not required
                              nullptr);
 
             // Restore
-            RenjuAIUtils::setCell(gs, r, c, 0);
+            RenjuAIUtils::setCell(gs, board_size, r, c, 0);
 
             // Update max score
             if (s > max_score) {
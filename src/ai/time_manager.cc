@@ -0,0 +1,47 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ai/time_manager.h>
+
+RenjuAITimeManager::RenjuAITimeManager() : limited(false), time_limit(0) {
+    start_time = soft_deadline = hard_deadline = std::chrono::steady_clock::now();
+}
+
+void RenjuAITimeManager::start(int time_limit) {
+    limited = true;
+    this->time_limit = time_limit;
+    start_time = std::chrono::steady_clock::now();
+    soft_deadline = start_time + std::chrono::milliseconds(static_cast<long long>(time_limit * kRenjuAiTimeSoftRatio));
+    hard_deadline = start_time + std::chrono::milliseconds(time_limit);
+}
+
+void RenjuAITimeManager::startUnlimited() {
+    limited = false;
+    time_limit = 0;
+    start_time = soft_deadline = hard_deadline = std::chrono::steady_clock::now();
+}
+
+long long RenjuAITimeManager::elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+bool RenjuAITimeManager::shouldStartIteration(long long last_iteration) const {
+    if (!limited) return true;
+    if (std::chrono::steady_clock::now() >= soft_deadline) return false;
+    return elapsed() + last_iteration * kRenjuAiTimeBranchingFactor * kRenjuAiTimeBranchingFactor <= time_limit;
+}
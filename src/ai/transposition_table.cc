@@ -0,0 +1,102 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ai/transposition_table.h>
+
+RenjuAITranspositionTable::RenjuAITranspositionTable() : entries(nullptr), mask(0) {}
+
+RenjuAITranspositionTable::~RenjuAITranspositionTable() {
+    delete[] entries;
+}
+
+void RenjuAITranspositionTable::resize(int size_mb) {
+    delete[] entries;
+    entries = nullptr;
+    mask = 0;
+    if (size_mb <= 0) return;
+
+    // 项数取不超过限制的2的幂，这样可以用位与代替取模
+    size_t max_entries = (static_cast<size_t>(size_mb) << 20) / sizeof(Slot);
+    size_t size = 1;
+    while ((size << 1) <= max_entries) size <<= 1;
+
+    entries = new Slot[size];
+    mask = size - 1;
+    clear();
+}
+
+void RenjuAITranspositionTable::clear() {
+    if (entries == nullptr) return;
+    for (size_t i = 0; i <= mask; ++i) {
+        entries[i].check.store(0, std::memory_order_relaxed);
+        entries[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool RenjuAITranspositionTable::probe(uint64_t key, Entry *result) const {
+    if (entries == nullptr) return false;
+    const Slot &slot = entries[key & mask];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+    // 键对不上：不同局面，或者正被其他线程改写
+    if ((check ^ data) != key) return false;
+
+    unpack(data, result);
+    if (result->bound == kBoundNone) return false;
+    result->key = key;
+    return true;
+}
+
+void RenjuAITranspositionTable::store(uint64_t key, int initial_depth, int depth, int bound, int score,
+                                      int move_r, int move_c) {
+    if (entries == nullptr) return;
+    Slot &slot = entries[key & mask];
+
+    // 同一局面只用更深的迭代、同一迭代中更深的搜索结果覆盖，不同局面直接替换
+    uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+    uint64_t old_check = slot.check.load(std::memory_order_relaxed);
+    if ((old_check ^ old_data) == key) {
+        Entry old;
+        unpack(old_data, &old);
+        if (old.bound != kBoundNone &&
+            (old.initial_depth > initial_depth || (old.initial_depth == initial_depth && old.depth > depth))) return;
+    }
+
+    uint64_t data = pack(initial_depth, depth, bound, score, move_r, move_c);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+// 分数类型只占2位，同一字节的高6位保存初始深度
+uint64_t RenjuAITranspositionTable::pack(int initial_depth, int depth, int bound, int score, int move_r, int move_c) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(score)) |
+           static_cast<uint64_t>(static_cast<uint8_t>(depth))  << 32 |
+           static_cast<uint64_t>(static_cast<uint8_t>(bound | initial_depth << 2)) << 40 |
+           static_cast<uint64_t>(static_cast<uint8_t>(move_r)) << 48 |
+           static_cast<uint64_t>(static_cast<uint8_t>(move_c)) << 56;
+}
+
+void RenjuAITranspositionTable::unpack(uint64_t data, Entry *result) {
+    result->score  = static_cast<int>(static_cast<uint32_t>(data));
+    result->depth  = static_cast<char>(static_cast<int8_t>(data >> 32));
+    result->bound  = static_cast<char>((data >> 40) & 3);
+    result->initial_depth = static_cast<char>((data >> 42) & 63);
+    result->move_r = static_cast<char>(static_cast<int8_t>(data >> 48));
+    result->move_c = static_cast<char>(static_cast<int8_t>(data >> 56));
+}
@@ -21,21 +21,20 @@
 
 // 判断这个下法是不是下在了远离棋局集中点以外的地方
 // 如果这个下法附近两个都没有其他棋子，就判断下在了远离棋局的地方
-bool RenjuAIUtils::remoteCell(const char *gs, int r, int c) {
+bool RenjuAIUtils::remoteCell(const char *gs, int board_size, int r, int c) {
     if (gs == nullptr) return false;
     for (int i = r - 2; i <= r + 2; ++i) {
-        if (i < 0 || i >= g_board_size) continue;
+        if (i < 0 || i >= board_size) continue;
         for (int j = c - 2; j <= c + 2; ++j) {
-            if (j < 0 || j >= g_board_size) continue;
-            if (gs[g_board_size * i + j] > 0) return false;
+            if (j < 0 || j >= board_size) continue;
+            if (gs[board_size * i + j] > 0) return false;
         }
     }
     return true;
 }
 
-void RenjuAIUtils::zobristInit(int size, uint64_t *z1, uint64_t *z2) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+void RenjuAIUtils::zobristInit(int size, uint64_t *z1, uint64_t *z2, uint64_t seed) {
+    std::mt19937_64 gen(seed);
     std::uniform_int_distribution<uint64_t> d(0, UINT64_MAX);
 
     // Generate random values
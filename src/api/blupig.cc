@@ -0,0 +1,162 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <api/blupig.h>
+#include <ai/engine.h>
+#include <api/renju_api.h>
+#include <atomic>
+#include <chrono>
+
+struct blupig_engine {
+    explicit blupig_engine(int board_size) :
+        engine(board_size),
+        search_depth(-1),
+        time_limit(5500),
+        num_threads(1),
+        stop(false),
+        stop_requests(0),
+        handled_stop_requests(0),
+        callback(nullptr),
+        user_data(nullptr) {}
+
+    RenjuAIEngine engine;
+    int search_depth;
+    int time_limit;
+    int num_threads;
+
+    // Stop flag polled by the search, set by blupig_stop and by the callback, cleared when a search starts.
+    // blupig_stop also counts its calls; calls not yet covered by a search stop the next one at its start
+    std::atomic<bool> stop;
+    std::atomic<unsigned int> stop_requests;
+    unsigned int handled_stop_requests;
+
+    // Callback of the search in progress
+    blupig_iteration_callback callback;
+    void *user_data;
+};
+
+// Forwards completed iterations to the caller's callback
+static void onIteration(void *data, const RenjuAISearchContext &, int depth, int score, int move_r, int move_c) {
+    blupig_engine *engine = static_cast<blupig_engine *>(data);
+    if (engine->callback != nullptr && engine->callback(engine->user_data, depth, score, move_r, move_c) != 0)
+        engine->stop.store(true, std::memory_order_relaxed);
+}
+
+int blupig_api_version(void) {
+    return BLUPIG_API_VERSION;
+}
+
+blupig_engine *blupig_create(int board_size) {
+    if (board_size < 5 || board_size > kRenjuAiMaxBoardSize) return nullptr;
+    try {
+        blupig_engine *engine = new blupig_engine(board_size);
+        engine->engine.setIterationCallback(onIteration, engine);
+        return engine;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void blupig_destroy(blupig_engine *engine) {
+    delete engine;
+}
+
+int blupig_set_option(blupig_engine *engine, int option, int value) {
+    if (engine == nullptr) return BLUPIG_ERROR_INVALID_ARGUMENT;
+
+    switch (option) {
+        case BLUPIG_OPTION_SEARCH_DEPTH:
+            if (value == 0 || value < -1 || value > 10) return BLUPIG_ERROR_INVALID_ARGUMENT;
+            engine->search_depth = value;
+            return BLUPIG_OK;
+        case BLUPIG_OPTION_TIME_LIMIT:
+            if (value < 0) return BLUPIG_ERROR_INVALID_ARGUMENT;
+            engine->time_limit = value;
+            return BLUPIG_OK;
+        case BLUPIG_OPTION_THREADS:
+            if (value < 1 || value > 256) return BLUPIG_ERROR_INVALID_ARGUMENT;
+            engine->num_threads = value;
+            return BLUPIG_OK;
+        case BLUPIG_OPTION_TT_SIZE:
+            if (value < 0 || value > 4096) return BLUPIG_ERROR_INVALID_ARGUMENT;
+            try {
+                engine->engine.setTranspositionTableSize(value);
+            } catch (...) {
+                return BLUPIG_ERROR_INTERNAL;
+            }
+            return BLUPIG_OK;
+        default:
+            return BLUPIG_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+int blupig_search(blupig_engine *engine, const char *state, int format, int ai_player,
+                  blupig_iteration_callback callback, void *user_data, blupig_result *result) {
+    if (engine == nullptr || state == nullptr || result == nullptr || ai_player < 1 || ai_player > 2)
+        return BLUPIG_ERROR_INVALID_ARGUMENT;
+
+    // Exceptions must not cross the C interface
+    try {
+        int board_size = engine->engine.boardSize();
+        char gs[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize];
+        if (!RenjuAPI::parseGameState(state, format, board_size, gs)) return BLUPIG_ERROR_INVALID_STATE;
+
+        // Only the changed cells are updated, so consecutive positions of a game reuse the caches
+        engine->engine.setPosition(gs);
+        engine->callback = callback;
+        engine->user_data = user_data;
+
+        // Clear the flag before reading the count: a blupig_stop counted after the read sets the flag
+        // again and is seen by the search, one counted before it ends this search right away
+        auto start = std::chrono::steady_clock::now();
+        int depth = 0, move_r = -1, move_c = -1, winning_player = 0;
+        engine->stop.store(false);
+        unsigned int stop_requests = engine->stop_requests.load();
+        bool searched = stop_requests == engine->handled_stop_requests;
+        if (searched) {
+            engine->engine.generateMove(ai_player, engine->search_depth, engine->time_limit, engine->num_threads,
+                                        &depth, &move_r, &move_c, &winning_player, &engine->stop);
+            stop_requests = engine->stop_requests.load();
+        }
+        auto end = std::chrono::steady_clock::now();
+        engine->callback = nullptr;
+        engine->user_data = nullptr;
+
+        // Stops requested until now belonged to this call
+        engine->handled_stop_requests = stop_requests;
+
+        result->move_r = move_r;
+        result->move_c = move_c;
+        result->winning_player = winning_player;
+        result->search_depth = move_r >= 0 ? depth : 0;
+        result->node_count = searched ? engine->engine.context().node_count : 0;
+        result->eval_count = searched ? engine->engine.context().eval_count : 0;
+        result->elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        return BLUPIG_OK;
+    } catch (...) {
+        engine->callback = nullptr;
+        return BLUPIG_ERROR_INTERNAL;
+    }
+}
+
+void blupig_stop(blupig_engine *engine) {
+    if (engine == nullptr) return;
+    engine->stop_requests.fetch_add(1);
+    engine->stop.store(true);
+}
@@ -18,39 +18,113 @@
 
 #include <api/renju_api.h>
 #include <ai/ai_controller.h>
+#include <ai/negamax.h>
+#include <ai/search_context.h>
 #include <ai/utils.h>
 #include <utils/globals.h>
+#include <atomic>
 #include <cstring>
+#include <thread>
+#include <vector>
 
 bool RenjuAPI::generateMove(const char *gs_string, int ai_player_id,
                             int search_depth, int time_limit, int num_threads,
                             int *actual_depth, int *move_r, int *move_c, int *winning_player,
-                            unsigned int *node_count, unsigned int *eval_count, unsigned int *pm_count) {
+                            uint64_t *node_count, uint64_t *eval_count, uint64_t *pm_count,
+                            uint64_t node_limit) {
     // Check input data
-    if (strlen(gs_string) != g_gs_size ||
+    if (gs_string == nullptr ||
         ai_player_id  < 1 || ai_player_id > 2 ||
         search_depth == 0 || search_depth > 10 ||
         time_limit < 0    ||
-        num_threads  < 1) {
+        num_threads  < 1  || num_threads > 256) {
         return false;
     }
 
-    // Copy game state
-    char *gs = new char[g_gs_size];
-    std::memcpy(gs, gs_string, g_gs_size);
-
     // Convert from string
-    gsFromString(gs_string, gs);
+    char gs[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize];
+    if (!parseGameState(gs_string, kRenjuAPIStateDigits, g_board_size, gs)) return false;
+
+    // Each call searches with its own context
+    RenjuAISearchContext ctx(g_board_size);
+    ctx.time_limit = time_limit;
+    ctx.node_limit = node_limit;
 
     // Generate move
-    RenjuAIController::generateMove(gs, ai_player_id, search_depth, time_limit, actual_depth,
-                                    move_r, move_c, winning_player, node_count, eval_count, pm_count);
+    RenjuAIController::generateMove(&ctx, gs, ai_player_id, search_depth, num_threads, actual_depth,
+                                    move_r, move_c, winning_player);
+
+    if (node_count != nullptr) *node_count = ctx.node_count;
+    if (eval_count != nullptr) *eval_count = ctx.eval_count;
+    if (pm_count != nullptr) *pm_count = ctx.pm_count;
 
-    // Release memory
-    delete[] gs;
     return true;
 }
 
+void RenjuAPI::generateMoves(const RenjuAPIMoveRequest *requests, size_t count, RenjuAPIMoveResult *results,
+                             int num_workers) {
+    if (requests == nullptr || results == nullptr || count == 0) return;
+    if (num_workers <= 0) num_workers = static_cast<int>(std::thread::hardware_concurrency());
+    if (num_workers <= 0) num_workers = 1;
+    if (static_cast<size_t>(num_workers) > count) num_workers = static_cast<int>(count);
+
+    // Workers share the process-wide transposition table, keep its size until the whole batch is done
+    RenjuAINegamax::SharedTableUse shared_table_use;
+
+    // Workers take the next position until none is left, each keeping its own search context
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        std::unique_ptr<RenjuAISearchContext> ctx;
+        for (size_t i = next++; i < count; i = next++) generateMove(requests[i], &results[i], &ctx);
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < num_workers; ++i) workers.emplace_back(work);
+    work();
+    for (auto &worker : workers) worker.join();
+}
+
+void RenjuAPI::generateMove(const RenjuAPIMoveRequest &request, RenjuAPIMoveResult *result,
+                            std::unique_ptr<RenjuAISearchContext> *ctx) {
+    if (result == nullptr || ctx == nullptr) return;
+    *result = RenjuAPIMoveResult();
+
+    // Check input data
+    int board_size = request.board_size;
+    if (board_size < 5 || board_size > kRenjuAiMaxBoardSize ||
+        request.ai_player_id < 1 || request.ai_player_id > 2 ||
+        request.search_depth == 0 || request.search_depth < -1 || request.search_depth > 10 ||
+        request.time_limit < 0 ||
+        request.num_threads < 1 || request.num_threads > 256) return;
+
+    char gs[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize];
+    if (!parseGameState(request.gs_string, request.state_format, board_size, gs)) return;
+
+    // Reuse the context while the board size stays the same
+    if (*ctx == nullptr || (*ctx)->board_size != board_size) ctx->reset(new RenjuAISearchContext(board_size));
+    RenjuAISearchContext *search_ctx = ctx->get();
+    search_ctx->time_limit = request.time_limit;
+    search_ctx->node_limit = request.node_limit;
+
+    RenjuAIController::generateMove(search_ctx, gs, request.ai_player_id, request.search_depth, request.num_threads,
+                                    &result->actual_depth, &result->move_r, &result->move_c,
+                                    &result->winning_player);
+
+    // Counted by the search's own threads, so positions searched concurrently do not add up
+    result->cpu_time = static_cast<int>(search_ctx->cpu_time / 1000);
+    result->node_count = search_ctx->node_count;
+    result->eval_count = search_ctx->eval_count;
+    result->pm_count = search_ctx->pm_count;
+    result->iterations = search_ctx->iterations;
+    result->success = true;
+}
+
+bool RenjuAPI::setTranspositionTableSize(int size_mb) {
+    // Limit to 4 GB
+    if (size_mb < 0 || size_mb > 4096) return false;
+    return RenjuAIController::setTranspositionTableSize(size_mb);
+}
+
 void RenjuAPI::gsFromString(const char *gs_string, char *gs) {
     if (strlen(gs_string) != g_gs_size) return;
     for (int i = 0; i < static_cast<int>(g_gs_size); i++) {
@@ -58,11 +132,157 @@ void RenjuAPI::gsFromString(const char *gs_string, char *gs) {
     }
 }
 
+// Unpadded base64url, usable in URLs, JSON and command lines without escaping
+static const char kBase64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static int base64Value(char ch) {
+    if (ch >= 'A' && ch <= 'Z') return ch - 'A';
+    if (ch >= 'a' && ch <= 'z') return ch - 'a' + 26;
+    if (ch >= '0' && ch <= '9') return ch - '0' + 52;
+    if (ch == '-') return 62;
+    if (ch == '_') return 63;
+    return -1;
+}
+
+static bool decodeBase64(const std::string &text, std::vector<unsigned char> *data) {
+    data->clear();
+    unsigned int buffer = 0;
+    int bits = 0;
+    for (char ch : text) {
+        int value = base64Value(ch);
+        if (value < 0) return false;
+        buffer = (buffer << 6) | static_cast<unsigned int>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            data->push_back(static_cast<unsigned char>(buffer >> bits));
+        }
+    }
+    // Only the padding of the last character may be left over, and it must be zero
+    return bits < 6 && (buffer & ((1u << bits) - 1)) == 0;
+}
+
+static std::string encodeBase64(const std::vector<unsigned char> &data) {
+    std::string text;
+    unsigned int buffer = 0;
+    int bits = 0;
+    for (unsigned char byte : data) {
+        buffer = (buffer << 8) | byte;
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            text.push_back(kBase64Chars[(buffer >> bits) & 63]);
+        }
+    }
+    if (bits > 0) text.push_back(kBase64Chars[(buffer << (6 - bits)) & 63]);
+    return text;
+}
+
+// Place the moves of a move list, alternating from black; only the listed cells are touched
+static bool gsFromMoves(const std::string &moves, int board_size, char *gs) {
+    memset(gs, 0, static_cast<size_t>(board_size * board_size));
+    char player = 1;
+    size_t i = 0;
+    while (i < moves.size()) {
+        char letter = moves[i++];
+        int c;
+        if (letter >= 'a' && letter <= 'z') {
+            c = letter - 'a';
+        } else if (letter >= 'A' && letter <= 'Z') {
+            c = letter - 'A';
+        } else {
+            return false;
+        }
+
+        int row = 0, digits = 0;
+        while (i < moves.size() && moves[i] >= '0' && moves[i] <= '9' && digits < 3) {
+            row = row * 10 + moves[i++] - '0';
+            digits++;
+        }
+        int r = row - 1;
+        if (digits == 0 || r < 0 || r >= board_size || c >= board_size) return false;
+        if (gs[board_size * r + c] != 0) return false;
+
+        gs[board_size * r + c] = player;
+        player = static_cast<char>(3 - player);
+    }
+    return true;
+}
+
+bool RenjuAPI::parseGameState(const std::string &state, int format, int board_size, char *gs) {
+    if (board_size < 5 || board_size > kRenjuAiMaxBoardSize || gs == nullptr) return false;
+    int gs_size = board_size * board_size;
+
+    if (format == kRenjuAPIStateDigits) {
+        if (static_cast<int>(state.size()) != gs_size) return false;
+        for (int i = 0; i < gs_size; ++i) {
+            if (state[i] < '0' || state[i] > '2') return false;
+            gs[i] = state[i] - '0';
+        }
+        return true;
+    }
+
+    if (format == kRenjuAPIStatePacked) {
+        std::vector<unsigned char> data;
+        return decodeBase64(state, &data) && gsFromPacked(data.data(), data.size(), board_size, gs);
+    }
+
+    if (format == kRenjuAPIStateMoves) return gsFromMoves(state, board_size, gs);
+    return false;
+}
+
+std::string RenjuAPI::formatGameState(const char *gs, int board_size, int format) {
+    if (format == kRenjuAPIStateDigits) {
+        std::string result(static_cast<size_t>(board_size * board_size), '0');
+        for (size_t i = 0; i < result.size(); ++i) result[i] = static_cast<char>(gs[i] + '0');
+        return result;
+    }
+
+    if (format == kRenjuAPIStatePacked) {
+        std::vector<unsigned char> data;
+        gsToPacked(gs, board_size, &data);
+        return encodeBase64(data);
+    }
+    return "";
+}
+
+bool RenjuAPI::gsFromPacked(const unsigned char *data, size_t size, int board_size, char *gs) {
+    int gs_size = board_size * board_size;
+    if (data == nullptr || size != static_cast<size_t>((gs_size + 3) / 4)) return false;
+
+    for (int i = 0; i < gs_size; i += 4) {
+        unsigned char byte = data[i / 4];
+        for (int j = 0; j < 4 && i + j < gs_size; ++j) {
+            int cell = (byte >> (2 * j)) & 3;
+            if (cell == 3) return false;
+            gs[i + j] = static_cast<char>(cell);
+        }
+        // Padding bits of the last byte must be empty
+        if (i + 4 > gs_size && (byte >> (2 * (gs_size - i))) != 0) return false;
+    }
+    return true;
+}
+
+void RenjuAPI::gsToPacked(const char *gs, int board_size, std::vector<unsigned char> *data) {
+    int gs_size = board_size * board_size;
+    data->assign(static_cast<size_t>((gs_size + 3) / 4), 0);
+    for (int i = 0; i < gs_size; ++i) {
+        (*data)[i / 4] |= static_cast<unsigned char>((gs[i] & 3) << (2 * (i % 4)));
+    }
+}
+
+int RenjuAPI::stateFormatFromName(const std::string &name) {
+    if (name == "digits") return kRenjuAPIStateDigits;
+    if (name == "packed") return kRenjuAPIStatePacked;
+    if (name == "moves") return kRenjuAPIStateMoves;
+    return -1;
+}
+
 std::string RenjuAPI::renderGameState(const char *gs) {
     std::string result = "";
     for (int r = 0; r < g_board_size; r++) {
         for (int c = 0; c < g_board_size; c++) {
-            result.push_back(RenjuAIUtils::getCell(gs, r, c) + '0');
+            result.push_back(RenjuAIUtils::getCell(gs, g_board_size, r, c) + '0');
             result.push_back(' ');
         }
         result.push_back('\n');
@@ -17,6 +17,7 @@
  */
 
 #include <protocols/cli.h>
+#include <protocols/daemon.h>
 #include <protocols/gomocup.h>
 #include <cstring>
 
@@ -26,10 +27,13 @@
 int main(int argc, char const *argv[]) {
     if (argc <= 0) return 1;
 
-    // Select Gomocup protocol if "pbrain' found in file name
+    // Select Gomocup protocol if "pbrain' found in file name,
+    // or the JSON daemon if the first argument is "daemon"
     bool success;
     if (strstr(argv[0], "pbrain") != nullptr) {
         success = RenjuProtocolGomocup::beginSession(argc, argv);
+    } else if (argc >= 2 && strcmp(argv[1], "daemon") == 0) {
+        success = RenjuProtocolDaemon::beginSession(argc, argv);
     } else {
         success = RenjuProtocolCLI::beginSession(argc, argv);
     }
@@ -17,33 +17,52 @@
  */
 
 #include <protocols/cli.h>
+#include <protocols/daemon.h>
 #include <api/renju_api.h>
 #include <utils/json.h>
 #include <utils/globals.h>
+#include <utils/stats.h>
 #include <ctime>
 #include <cstdlib>
 #include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 bool RenjuProtocolCLI::beginSession(int argc, char const *argv[]) {
     // Print usage if no arguments provided
     if (argc < 2) {
         std::cerr << "Usage: renju" << std::endl;
         std::cerr << "        -s <state>       The game state (required)" << std::endl;
+        std::cerr << "       [-f <format>]     State format (digits, packed or moves; default: digits)" << std::endl;
         std::cerr << "       [-p <ai_player>]  AI player (1: black, 2: white; default: 1)" << std::endl;
         std::cerr << "       [-d <depth>]      AI Search depth (iterative deepening)" << std::endl;
         std::cerr << "       [-l <time_limit>] Execution time limit for iterative deepening (5000)" << std::endl;
+        std::cerr << "       [-n <node_limit>] Node limit for iterative deepening instead of time (0: off)" << std::endl;
         std::cerr << "       [-t <threads>]    Number of threads (1)" << std::endl;
+        std::cerr << "       [-m <tt_size>]    Transposition table size in MB (16, 0 to disable)" << std::endl;
+        std::cerr << "   or: renju -b [-w <workers>] [-m <tt_size>]" << std::endl;
+        std::cerr << "                          Batch mode: one JSON request per line on stdin (same" << std::endl;
+        std::cerr << "                          format as the daemon), responses in input order on stdout" << std::endl;
         return false;
     }
 
     // Initialize arguments
     g_board_size = 15;
     g_gs_size = (unsigned int)g_board_size * g_board_size;
-    char gs_string[226] = {0};
+    char gs_string[362] = {0};
     int ai_player = 1;
     int num_threads = 1;
     int search_depth = -1;
     int time_limit = 5500;
+    int tt_size = -1;
+    int node_limit = 0;
+    const char *state_arg = nullptr;
+    int state_format = kRenjuAPIStateDigits;
+    bool batch = false;
+    int num_workers = 0;
 
     // Iterate through arguments
     for (int i = 0; i < argc; i++) {
@@ -53,9 +72,13 @@ bool RenjuProtocolCLI::beginSession(int argc, char const *argv[]) {
             // Check if value exists
             if (i >= argc - 1) continue;
 
-            // Validate and copy state
-            if (validateString(argv[i + 1], 225) == 225)
-                memcpy(gs_string, argv[i + 1], 225);
+            // Decoded once the format is known
+            state_arg = argv[i + 1];
+
+        } else if (strncmp(arg, "-f", 2) == 0) {
+            // State format
+            if (i >= argc - 1) continue;
+            state_format = RenjuAPI::stateFormatFromName(argv[i + 1]);
 
         } else if (strncmp(arg, "-p", 2) == 0) {
             // AI player ID
@@ -72,28 +95,107 @@ bool RenjuProtocolCLI::beginSession(int argc, char const *argv[]) {
             if (i >= argc - 1) continue;
             parseIntegerArgument(argv[i + 1], 8, &time_limit);
 
+        } else if (strncmp(arg, "-n", 2) == 0) {
+            // Node limit
+            if (i >= argc - 1) continue;
+            parseIntegerArgument(argv[i + 1], 9, &node_limit);
+
         } else if (strncmp(arg, "-t", 2) == 0) {
             // Number of threads
             if (i >= argc - 1) continue;
             parseIntegerArgument(argv[i + 1], 3, &num_threads);
 
+        } else if (strncmp(arg, "-m", 2) == 0) {
+            // Transposition table size
+            if (i >= argc - 1) continue;
+            parseIntegerArgument(argv[i + 1], 4, &tt_size);
+
+        } else if (strncmp(arg, "-b", 2) == 0) {
+            // Batch mode
+            batch = true;
+
+        } else if (strncmp(arg, "-w", 2) == 0) {
+            // Number of batch workers
+            if (i >= argc - 1) continue;
+            parseIntegerArgument(argv[i + 1], 3, &num_workers);
+
         } else if (strncmp(arg, "test", 4) == 0) {
-            // Build test data
+            // Build test data (recorded on a 19x19 board)
+            g_board_size = 19;
+            g_gs_size = (unsigned int)g_board_size * g_board_size;
             memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000002121000000000000001211112000000000000022122110000000000001211002200000000000002010200000000000000000200000000000000000100000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
             search_depth = 8;
             ai_player = 2;
         }
     }
 
-    std::string result = generateMove(gs_string, ai_player, search_depth, time_limit, num_threads);
+    if (tt_size >= 0 && !RenjuAPI::setTranspositionTableSize(tt_size)) {
+        std::cout << generateResultJson(nullptr, "Invalid input data.") << std::endl;
+        return false;
+    }
+
+    if (batch) return generateMoves(num_workers);
+
+    // Validate the state and convert it to digits
+    if (state_arg != nullptr && validateString(state_arg, 1024) > 0) {
+        char gs[225];
+        if (RenjuAPI::parseGameState(state_arg, state_format, 15, gs))
+            memcpy(gs_string, RenjuAPI::formatGameState(gs, 15, kRenjuAPIStateDigits).c_str(), 225);
+    }
+
+    if (node_limit < 0) node_limit = 0;
+    std::string result = generateMove(gs_string, ai_player, search_depth, time_limit, num_threads, node_limit);
     std::cout << result << std::endl;
 
     return true;
 }
 
 bool RenjuProtocolCLI::parseIntegerArgument(const char *str, int max_length, int *result) {
-    if (validateString(str, max_length) < 0) return false;
-    *result = (int)strtol(str, nullptr, 10);
+    if (validateString(str, max_length) <= 0) return false;
+    char *end;
+    long value = strtol(str, &end, 10);
+    if (*end != 0) return false;
+    *result = (int)value;
+    return true;
+}
+
+bool RenjuProtocolCLI::generateMoves(int num_workers) {
+    if (num_workers <= 0) num_workers = static_cast<int>(std::thread::hardware_concurrency());
+    if (num_workers <= 0) num_workers = 1;
+
+    // Read a few requests per worker at a time, so results stream out while stdin is still being read
+    size_t chunk_size = static_cast<size_t>(num_workers) * kRenjuCLIBatchRequestsPerWorker;
+    std::vector<RenjuAPIMoveRequest> requests;
+    std::vector<nlohmann::json> ids;
+    std::vector<RenjuAPIMoveResult> results;
+
+    std::string line;
+    bool eof = false;
+    while (!eof) {
+        requests.clear();
+        ids.clear();
+        while (requests.size() < chunk_size) {
+            if (!std::getline(std::cin, line)) {
+                eof = true;
+                break;
+            }
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+
+            requests.emplace_back();
+            ids.emplace_back();
+            // Leave no state to search for lines that failed to parse
+            if (!RenjuProtocolDaemon::parseRequest(line, &requests.back(), &ids.back()))
+                requests.back().gs_string.clear();
+        }
+        if (requests.empty()) break;
+
+        results.resize(requests.size());
+        RenjuAPI::generateMoves(requests.data(), requests.size(), results.data(), num_workers);
+        for (size_t i = 0; i < requests.size(); ++i)
+            std::cout << RenjuProtocolDaemon::formatResponse(ids[i], requests[i], results[i]) << '\n';
+        std::cout.flush();
+    }
     return true;
 }
 
@@ -108,17 +210,25 @@ int RenjuProtocolCLI::validateString(const char *str, int max_length) {
 }
 
 std::string RenjuProtocolCLI::generateMove(const char *gs_string, int ai_player_id, int search_depth,
-                                           int time_limit, int num_threads) {
+                                           int time_limit, int num_threads, int node_limit) {
     // Record start time
     std::clock_t clock_begin = std::clock();
 
     // Generate move
-    int move_r, move_c, winning_player, actual_depth;
-    unsigned int node_count, eval_count, pm_count;
-    bool success = RenjuAPI::generateMove(gs_string, ai_player_id, search_depth, time_limit, num_threads, &actual_depth,
-                                          &move_r, &move_c, &winning_player, &node_count, &eval_count, &pm_count);
+    RenjuAPIMoveRequest request;
+    request.gs_string = gs_string;
+    request.board_size = g_board_size;
+    request.ai_player_id = ai_player_id;
+    request.search_depth = search_depth;
+    request.time_limit = time_limit;
+    request.node_limit = static_cast<uint64_t>(node_limit);
+    request.num_threads = num_threads;
+
+    RenjuAPIMoveResult move;
+    std::unique_ptr<RenjuAISearchContext> ctx;
+    RenjuAPI::generateMove(request, &move, &ctx);
 
-    if (!success) return generateResultJson(nullptr, "Invalid input data.");
+    if (!move.success) return generateResultJson(nullptr, "Invalid input data.");
 
     // Calculate elapsed CPU time
     std::clock_t clock_end = std::clock();
@@ -129,32 +239,38 @@ std::string RenjuProtocolCLI::generateMove(const char *gs_string, int ai_player_
     build_datetime = build_datetime + " " + __TIME__;
 
     // Generate result map
-    std::unordered_map<std::string, std::string> data = {{"move_r", std::to_string(move_r)},
-                                                         {"move_c", std::to_string(move_c)},
-                                                         {"winning_player", std::to_string(winning_player)},
+    std::unordered_map<std::string, std::string> data = {{"move_r", std::to_string(move.move_r)},
+                                                         {"move_c", std::to_string(move.move_c)},
+                                                         {"winning_player", std::to_string(move.winning_player)},
                                                          {"ai_player", std::to_string(ai_player_id)},
-                                                         {"search_depth", std::to_string(actual_depth)},
+                                                         {"search_depth", std::to_string(move.actual_depth)},
                                                          {"cpu_time", std::to_string(cpu_time)},
                                                          {"num_threads", std::to_string(num_threads)},
-                                                         {"node_count", std::to_string(node_count)},
-                                                         {"eval_count", std::to_string(eval_count)},
-                                                         {"pm_count", std::to_string(pm_count)},
+                                                         {"node_count", std::to_string(move.node_count)},
+                                                         {"eval_count", std::to_string(move.eval_count)},
+                                                         {"pm_count", std::to_string(move.pm_count)},
                                                          {"cc_0", std::to_string(g_cc_0)},
                                                          {"cc_1", std::to_string(g_cc_1)},
                                                          {"build", build_datetime}};
 
-    // Result
-    return generateResultJson(&data, "ok");
+    // Result, with the statistics of each iteration
+    nlohmann::json iterations = RenjuProtocolDaemon::formatIterations(move.iterations);
+    return generateResultJson(&data, "ok", &iterations);
 }
 
 std::string RenjuProtocolCLI::generateResultJson(const std::unordered_map<std::string, std::string> *data,
-                                                 const std::string &message) {
+                                                 const std::string &message, const nlohmann::json *iterations) {
     nlohmann::json result;
     if (data != nullptr) {
         // Add all k-v pairs to the result map
         for (auto pair : *data) {
             result["result"][pair.first] = pair.second;
         }
+        if (iterations != nullptr) result["result"]["iterations"] = *iterations;
+#ifdef BLUPIG_STATS
+        // Instrumentation totals of a stats build
+        result["result"]["stats"] = RenjuStats::toJson();
+#endif
     } else {
         result["result"] = nullptr;
     }
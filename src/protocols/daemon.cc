@@ -0,0 +1,305 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <protocols/daemon.h>
+#include <protocols/cli.h>
+#include <utils/json.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+std::deque<RenjuProtocolDaemon::Job> RenjuProtocolDaemon::jobs;
+std::mutex RenjuProtocolDaemon::jobs_mutex;
+std::condition_variable RenjuProtocolDaemon::jobs_cv;
+bool RenjuProtocolDaemon::shutting_down = false;
+
+bool RenjuProtocolDaemon::beginSession(int argc, char const *argv[]) {
+    // Options: -w <workers>  Number of worker threads (number of cores)
+    //          -u <path>     Listen on a Unix socket instead of stdin/stdout
+    //          -m <tt_size>  Transposition table size in MB
+    int num_workers = static_cast<int>(std::thread::hardware_concurrency());
+    const char *socket_path = nullptr;
+    int tt_size = -1;
+    bool valid = true;
+    for (int i = 2; i < argc; i++) {
+        if (i == argc - 1) {
+            valid = false;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            valid = RenjuProtocolCLI::parseIntegerArgument(argv[++i], 3, &num_workers) && num_workers >= 1;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            valid = RenjuProtocolCLI::parseIntegerArgument(argv[++i], 4, &tt_size) &&
+                    RenjuAPI::setTranspositionTableSize(tt_size);
+        } else {
+            valid = false;
+        }
+        if (!valid) break;
+    }
+    if (num_workers < 1) num_workers = 1;
+
+    // Refuse to start with invalid options
+    if (!valid) {
+        std::cerr << "Usage: renju daemon [-w <workers>] [-u <socket_path>] [-m <tt_size>]" << std::endl;
+        std::cerr << "        -w <workers>     Number of worker threads (default: number of cores)" << std::endl;
+        std::cerr << "        -u <socket_path> Listen on a Unix socket instead of stdin/stdout" << std::endl;
+        std::cerr << "        -m <tt_size>     Transposition table size in MB (0 to 4096)" << std::endl;
+        return false;
+    }
+
+    // Clients going away must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_workers; ++i) workers.emplace_back(workerLoop);
+
+    bool success = true;
+    if (socket_path != nullptr) {
+        success = serveSocket(socket_path);
+    } else {
+        readConnection(STDIN_FILENO, std::make_shared<Connection>(STDOUT_FILENO));
+    }
+
+    // Finish the queued requests, then stop the workers
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        shutting_down = true;
+    }
+    jobs_cv.notify_all();
+    for (auto &worker : workers) worker.join();
+
+    return success;
+}
+
+std::string RenjuProtocolDaemon::handleRequest(const std::string &line, std::unique_ptr<RenjuAISearchContext> *ctx) {
+    RenjuAPIMoveRequest request;
+    RenjuAPIMoveResult result;
+    nlohmann::json id;
+
+    // The worker's context is kept between requests on the same board size
+    if (parseRequest(line, &request, &id)) RenjuAPI::generateMove(request, &result, ctx);
+    return formatResponse(id, request, result);
+}
+
+bool RenjuProtocolDaemon::parseRequest(const std::string &line, RenjuAPIMoveRequest *request, nlohmann::json *id) {
+    *id = nullptr;
+    nlohmann::json json;
+    try {
+        json = nlohmann::json::parse(line);
+    } catch (const std::exception &) {
+        return false;
+    }
+    if (!json.is_object()) return false;
+    if (json.count("id") > 0) *id = json["id"];
+
+    // Read parameters, absent ones keep the CLI defaults; values are validated by RenjuAPI
+    try {
+        request->gs_string = json.at("s").get<std::string>();
+        if (json.count("f") > 0) request->state_format = RenjuAPI::stateFormatFromName(json["f"].get<std::string>());
+        if (json.count("size") > 0) request->board_size = json["size"].get<int>();
+        if (json.count("p") > 0) request->ai_player_id = json["p"].get<int>();
+        if (json.count("d") > 0) request->search_depth = json["d"].get<int>();
+        if (json.count("l") > 0) request->time_limit = json["l"].get<int>();
+        if (json.count("n") > 0) request->node_limit = json["n"].get<uint64_t>();
+        if (json.count("t") > 0) request->num_threads = json["t"].get<int>();
+    } catch (const std::exception &) {
+        return false;
+    }
+    return true;
+}
+
+std::string RenjuProtocolDaemon::formatResponse(const nlohmann::json &id, const RenjuAPIMoveRequest &request,
+                                                const RenjuAPIMoveResult &result) {
+    nlohmann::json response;
+    response["id"] = id;
+    response["result"] = nullptr;
+    response["message"] = "Invalid input data.";
+    if (!result.success) return response.dump();
+
+    // Same result fields as the CLI
+    std::string build_datetime = __DATE__;
+    build_datetime = build_datetime + " " + __TIME__;
+    nlohmann::json &fields = response["result"];
+    fields["move_r"] = std::to_string(result.move_r);
+    fields["move_c"] = std::to_string(result.move_c);
+    fields["winning_player"] = std::to_string(result.winning_player);
+    fields["ai_player"] = std::to_string(request.ai_player_id);
+    fields["search_depth"] = std::to_string(result.actual_depth);
+    fields["cpu_time"] = std::to_string(result.cpu_time);
+    fields["num_threads"] = std::to_string(request.num_threads);
+    fields["node_count"] = std::to_string(result.node_count);
+    fields["eval_count"] = std::to_string(result.eval_count);
+    fields["pm_count"] = std::to_string(result.pm_count);
+    fields["iterations"] = formatIterations(result.iterations);
+    fields["build"] = build_datetime;
+    response["message"] = "ok";
+    return response.dump();
+}
+
+nlohmann::json RenjuProtocolDaemon::formatIterations(const std::vector<RenjuAIIterationStats> &iterations) {
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto &stats : iterations) {
+        nlohmann::json iteration;
+        iteration["depth"] = stats.depth;
+        iteration["time"] = stats.elapsed;
+        iteration["node_count"] = stats.node_count;
+        iteration["branching_factor"] = stats.branching_factor;
+        iteration["beta_cutoff_rate"] = stats.beta_cutoff_rate;
+        iteration["first_move_cutoff_rate"] = stats.first_move_cutoff_rate;
+        iteration["tt_hit_rate"] = stats.tt_hit_rate;
+        iteration["move_r"] = stats.move_r;
+        iteration["move_c"] = stats.move_c;
+        iteration["score"] = stats.score;
+
+        // Moves as [r, c] pairs, starting with the move found
+        nlohmann::json pv = nlohmann::json::array();
+        for (const auto &move : stats.pv) pv.push_back({move.r, move.c});
+        iteration["pv"] = pv;
+        result.push_back(iteration);
+    }
+    return result;
+}
+
+RenjuProtocolDaemon::Connection::~Connection() {
+    if (fd > STDERR_FILENO) close(fd);
+}
+
+void RenjuProtocolDaemon::Connection::shutdownRead() {
+    shutdown(fd, SHUT_RD);
+}
+
+void RenjuProtocolDaemon::Connection::writeLine(const std::string &line) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string data = line + "\n";
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n <= 0) return;
+        written += static_cast<size_t>(n);
+    }
+}
+
+void RenjuProtocolDaemon::workerLoop() {
+    std::unique_ptr<RenjuAISearchContext> ctx;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, [] { return !jobs.empty() || shutting_down; });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job.connection->writeLine(handleRequest(job.line, &ctx));
+    }
+}
+
+void RenjuProtocolDaemon::enqueue(const std::string &line, const std::shared_ptr<Connection> &connection) {
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.push_back(Job{line, connection});
+    }
+    jobs_cv.notify_one();
+}
+
+void RenjuProtocolDaemon::readConnection(int fd, std::shared_ptr<Connection> connection) {
+    std::string buffer;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer.append(chunk, static_cast<size_t>(n));
+
+        // Queue every complete line
+        size_t begin = 0, end;
+        while ((end = buffer.find('\n', begin)) != std::string::npos) {
+            std::string line = buffer.substr(begin, end - begin);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) enqueue(line, connection);
+            begin = end + 1;
+        }
+        buffer.erase(0, begin);
+    }
+    if (!buffer.empty()) enqueue(buffer, connection);
+}
+
+bool RenjuProtocolDaemon::serveSocket(const char *path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (server_fd < 0 ||
+        bind(server_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        listen(server_fd, 16) < 0) {
+        std::cerr << "Cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        if (server_fd >= 0) close(server_fd);
+        return false;
+    }
+
+    // Serve until the socket fails; a signal or a client that went away before being accepted is not a failure
+    std::vector<Reader> readers;
+    while (true) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "Cannot accept on " << path << ": " << strerror(errno) << std::endl;
+            break;
+        }
+        joinReaders(&readers, false);
+
+        Reader reader;
+        auto connection = std::make_shared<Connection>(client_fd);
+        reader.connection = connection;
+        reader.done = std::make_shared<std::atomic<bool>>(false);
+        reader.thread = std::thread([client_fd, connection, done = reader.done] {
+            readConnection(client_fd, connection);
+            done->store(true);
+        });
+        readers.push_back(std::move(reader));
+    }
+
+    // Stop reading from the remaining clients, their queued requests are still answered
+    joinReaders(&readers, true);
+    close(server_fd);
+    unlink(path);
+    return false;
+}
+
+void RenjuProtocolDaemon::joinReaders(std::vector<Reader> *readers, bool all) {
+    for (auto it = readers->begin(); it != readers->end();) {
+        if (!all && !it->done->load()) {
+            ++it;
+            continue;
+        }
+
+        // The connection is only alive while its reader or queued requests hold it
+        if (auto connection = it->connection.lock()) connection->shutdownRead();
+        it->thread.join();
+        it = readers->erase(it);
+    }
+}
@@ -17,30 +17,78 @@
  */
 
 #include <protocols/gomocup.h>
-#include <api/renju_api.h>
+#include <protocols/cli.h>
 #include <utils/globals.h>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
+int RenjuProtocolGomocup::num_threads = 1;
+int RenjuProtocolGomocup::tt_size = -1;
+RenjuProtocolGomocupTime RenjuProtocolGomocup::time;
+RenjuProtocolGomocup::Ponder RenjuProtocolGomocup::ponder;
+RenjuAIEngine *RenjuProtocolGomocup::engine = nullptr;
+
 bool RenjuProtocolGomocup::beginSession(int argc, char const *argv[]) {
     char line[256];
-    char *gs_string = nullptr;
+    bool started = false;
     bool errored = false;
-    int time_limit = 1500;
+    engine = new RenjuAIEngine();
+
+    // Options: -m <tt_size>  Transposition table size in MB
+    //          -t <threads>  Number of search threads
+    //          -p            Ponder on the opponent's time
+    ponder.enabled = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-p", 2) == 0) ponder.enabled = true;
+    }
+    for (int i = 1; i < argc - 1; i++) {
+        bool valid = true;
+        if (strncmp(argv[i], "-m", 2) == 0) {
+            valid = RenjuProtocolCLI::parseIntegerArgument(argv[i + 1], 4, &tt_size) &&
+                    tt_size >= 0 && tt_size <= 4096;
+            if (valid) engine->setTranspositionTableSize(tt_size);
+        }
+        if (strncmp(argv[i], "-t", 2) == 0) {
+            valid = RenjuProtocolCLI::parseIntegerArgument(argv[i + 1], 3, &num_threads) &&
+                    num_threads >= 1 && num_threads <= 256;
+        }
+
+        // Refuse to start rather than play with a setting the user did not ask for
+        if (!valid) {
+            std::cerr << "Usage: pbrain-* [-m <tt_size>] [-t <threads>] [-p]" << std::endl;
+            std::cerr << "        -m <tt_size>  Transposition table size in MB (0 to 4096)" << std::endl;
+            std::cerr << "        -t <threads>  Number of search threads (1 to 256)" << std::endl;
+            std::cerr << "        -p            Ponder on the opponent's time" << std::endl;
+            delete engine;
+            engine = nullptr;
+            return false;
+        }
+    }
 
     while (std::cin.getline(line, 256)) {
+        // Any command ends pondering, its result is kept for the next move
+        stopPondering();
+
         // Commands
-        if (strncmp(line, "START", 5) == 0) {
-            // START
-            unsigned int board_size = (unsigned int)atoi(&line[6]);
+        if (strncmp(line, "START", 5) == 0 || strncmp(line, "RECTSTART", 9) == 0) {
+            // START [SIZE] or RECTSTART [WIDTH],[HEIGHT], only square boards are supported
+            unsigned int board_size = 0;
+            if (line[0] == 'S') {
+                board_size = (unsigned int)atoi(&line[6]);
+            } else {
+                int values[2] = {-1, -1};
+                splitLine(&line[10], values);
+                if (values[0] == values[1]) board_size = (unsigned int)values[0];
+            }
             if (board_size >= 15 && board_size <= 20) {
                 g_board_size = board_size;
                 g_gs_size = (unsigned int)g_board_size * g_board_size;
 
                 // Initialize game state
-                gs_string = new char[g_gs_size + 1];
-                memset(gs_string, 0, g_gs_size + 1);
-                memset(gs_string, '0', g_gs_size);
+                engine->reset(board_size);
+                started = true;
 
                 // Write output
                 writeStdout("OK");
@@ -49,39 +97,53 @@ bool RenjuProtocolGomocup::beginSession(int argc, char const *argv[]) {
                 errored = true;
                 break;
             }
+        } else if (strncmp(line, "RESTART", 7) == 0) {
+            // RESTART
+            // Check board status
+            if (!started) {
+                writeStdout("ERROR");
+                errored = true;
+                break;
+            }
+
+            // New game on the same board, the transposition table stays warm
+            engine->reset(g_board_size);
+            writeStdout("OK");
+
         } else if (strncmp(line, "END", 3) == 0) {
             // END
             break;
         } else if (strncmp(line, "BEGIN", 5) == 0) {
             // BEGIN [SIZE]
             // Check board status
-            if (gs_string == nullptr) {
+            if (!started) {
                 writeStdout("ERROR");
                 errored = true;
                 break;
             }
 
             // Reset board
-            memset(gs_string, '0', g_gs_size);
+            engine->reset(g_board_size);
 
             // Put a piece in center
             int move_r = g_board_size / 2, move_c = g_board_size / 2;
-            gs_string[g_board_size * move_r + move_c] = '1';
+            engine->play(move_r, move_c, 1);
 
             // Write output
             std::cout << move_c << "," << move_r << std::endl;
+            startPondering();
 
         } else if (strncmp(line, "BOARD", 5) == 0) {
             // BOARD
             // Check board status
-            if (gs_string == nullptr) {
+            if (!started) {
                 writeStdout("ERROR");
                 errored = true;
                 break;
             }
 
-            // Reset board
-            memset(gs_string, '0', g_gs_size);
+            // Collect the position, then apply only the differences to the engine's board
+            char gs[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize] = {0};
 
             while (std::cin.getline(line, 256)) {
                 // [X],[Y],[field]
@@ -92,24 +154,27 @@ bool RenjuProtocolGomocup::beginSession(int argc, char const *argv[]) {
                     int values[3] = {-1, -1, -1};
                     splitLine(line, values);
 
-                    if (values[2] == -1) {
+                    if (values[2] == -1 ||
+                        values[0] < 0 || values[0] >= g_board_size || values[1] < 0 || values[1] >= g_board_size) {
                         writeStdout("ERROR");
                         errored = true;
                         break;
                     }
 
                     // Update board
-                    gs_string[g_board_size * values[1] + values[0]] = '0' + static_cast<char>(values[2]);
+                    gs[g_board_size * values[1] + values[0]] = static_cast<char>(values[2]);
                 }
             }
+            if (errored) break;
+            engine->setPosition(gs);
 
             // Generate, perform a move and write to stdout
-            performAndWriteMove(gs_string, time_limit);
+            performAndWriteMove();
 
         } else if (strncmp(line, "TURN", 4) == 0) {
             // TURN [X],[Y]
             // Check board status
-            if (gs_string == nullptr) {
+            if (!started) {
                 writeStdout("ERROR");
                 errored = true;
                 break;
@@ -121,23 +186,80 @@ bool RenjuProtocolGomocup::beginSession(int argc, char const *argv[]) {
             splitLine(&line[5], values);
             move_c = values[0]; move_r = values[1];
 
-            if (move_r == -1 || move_r >= g_board_size || move_c >= g_board_size) {
+            // Update board
+            if (move_r < 0 || move_c < 0 || move_r >= g_board_size || move_c >= g_board_size ||
+                !engine->play(move_r, move_c, 2)) {
                 writeStdout("ERROR");
                 errored = true;
                 break;
             }
 
+            // Generate, perform a move and write to stdout
+            performAndWriteMove();
+
+        } else if (strncmp(line, "TAKEBACK", 8) == 0 || strncmp(line, "PLAY", 4) == 0) {
+            // TAKEBACK [X],[Y] removes a stone, PLAY [X],[Y] plays our move given by the manager
+            // Check board status
+            if (!started) {
+                writeStdout("ERROR");
+                errored = true;
+                break;
+            }
+
+            // Read move
+            bool takeback = line[0] == 'T';
+            int values[2] = {-1, -1};
+            int move_r, move_c;
+            splitLine(&line[takeback ? 9 : 5], values);
+            move_c = values[0]; move_r = values[1];
+
             // Update board
-            gs_string[g_board_size * move_r + move_c] = '2';
+            if (move_r < 0 || move_c < 0 || move_r >= g_board_size || move_c >= g_board_size ||
+                !(takeback ? engine->remove(move_r, move_c) : engine->play(move_r, move_c, 1))) {
+                writeStdout("ERROR");
+                errored = true;
+                break;
+            }
 
-            // Generate, perform a move and write to stdout
-            performAndWriteMove(gs_string, time_limit);
+            // Write output
+            if (takeback) writeStdout("OK");
+            else          std::cout << move_c << "," << move_r << std::endl;
+
+        } else if (strncmp(line, "SWAP2BOARD", 10) == 0) {
+            // SWAP2BOARD
+            // Check board status
+            if (!started) {
+                writeStdout("ERROR");
+                errored = true;
+                break;
+            }
+
+            // [X],[Y] of the opening stones in placing order, black first
+            int moves[5][2];
+            int move_count = 0;
+            while (std::cin.getline(line, 256)) {
+                if (strncmp(line, "DONE", 4) == 0) break;
+
+                int values[2] = {-1, -1};
+                splitLine(line, values);
+                if (move_count >= 5 ||
+                    values[0] < 0 || values[0] >= g_board_size || values[1] < 0 || values[1] >= g_board_size) {
+                    writeStdout("ERROR");
+                    errored = true;
+                    break;
+                }
+                moves[move_count][0] = values[1];
+                moves[move_count][1] = values[0];
+                ++move_count;
+            }
+            if (errored) break;
+
+            // Choose a color or propose an opening
+            performSwap2(moves, move_count);
 
         } else if (strncmp(line, "INFO", 4) == 0) {
             // INFO [key] [value]
-            if (strncmp(line + 5, "timeout_turn", 12) == 0) {
-                time_limit = atoi(line + 5 + 12 + 1) + 500;
-            }
+            handleInfo(line + 5);
         } else if (strncmp(line, "ABOUT", 5) == 0) {
             std::string build_datetime = __DATE__;
             build_datetime = build_datetime + " " + __TIME__;
@@ -149,40 +271,175 @@ bool RenjuProtocolGomocup::beginSession(int argc, char const *argv[]) {
     }
 
     // Release memory
-    if (gs_string != nullptr) delete[] gs_string;
+    stopPondering();
+    delete engine;
+    engine = nullptr;
 
     return !errored;
 }
 
-void RenjuProtocolGomocup::performAndWriteMove(char *gs_string, int time_limit) {
-    // Generate move
-    int move_r, move_c, winning_player, actual_depth;
-    unsigned int node_count, eval_count;
-    bool success = RenjuAPI::generateMove(gs_string, 1, -1, time_limit, 1, &actual_depth, &move_r, &move_c,
-                                          &winning_player, &node_count, &eval_count, nullptr);
+void RenjuProtocolGomocup::performAndWriteMove() {
+    int move_r, move_c;
+    if (performMove(&move_r, &move_c)) {
+        // Write output
+        std::cout << move_c << "," << move_r << std::endl;
+        startPondering();
+    } else {
+        writeStdout("ERROR");
+    }
+}
 
-    if (success) {
-        // Write MESSAGE
+bool RenjuProtocolGomocup::performMove(int *move_r, int *move_c) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Split the remaining time by the number of moves already played
+    int own_moves = 0;
+    for (int r = 0; r < g_board_size; ++r)
+        for (int c = 0; c < g_board_size; ++c)
+            if (engine->board().cell(r, c) == 1) ++own_moves;
+    int time_limit = time.turnTimeLimit(own_moves);
+
+    // Generate move, answering instantly when pondering already searched this position long enough
+    int winning_player, actual_depth;
+    *move_r = -1;
+    *move_c = -1;
+    bool ponder_hit = ponderHit(time_limit, &actual_depth, move_r, move_c);
+    if (!ponder_hit)
+        engine->generateMove(1, -1, time_limit, num_threads, &actual_depth, move_r, move_c, &winning_player);
+
+    time.moveFinished(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - start).count()));
+
+    if (!engine->play(*move_r, *move_c, 1)) return false;
+
+    // Write MESSAGE
+    if (ponder_hit) {
         std::cout << "MESSAGE" <<
                      " d=" << actual_depth <<
-                     " node_cnt=" << node_count <<
-                     " eval_cnt=" << eval_count << std::endl;
+                     " ponder_hit" << std::endl;
+    } else {
+        std::cout << "MESSAGE" <<
+                     " d=" << actual_depth <<
+                     " node_cnt=" << engine->context().node_count <<
+                     " eval_cnt=" << engine->context().eval_count << std::endl;
+    }
+    return true;
+}
 
-        // Update board
-        gs_string[g_board_size * move_r + move_c] = '1';
+void RenjuProtocolGomocup::performSwap2(const int moves[][2], int move_count) {
+    // With no stones, propose a three-stone opening around the center and expect to play black
+    if (move_count == 0) {
+        int center = g_board_size / 2;
+        int opening[3][2] = {{center, center}, {center - 1, center + 1}, {center + 1, center + 1}};
+        engine->reset(g_board_size);
+        for (int i = 0; i < 3; ++i) engine->play(opening[i][0], opening[i][1], i % 2 == 0 ? 1 : 2);
+        std::cout << opening[0][1] << "," << opening[0][0] << " " <<
+                     opening[1][1] << "," << opening[1][0] << " " <<
+                     opening[2][1] << "," << opening[2][0] << std::endl;
+        return;
+    }
+    if (move_count != 3 && move_count != 5) {
+        writeStdout("ERROR");
+        return;
+    }
 
-        // Write output
-        std::cout << move_c << "," << move_r << std::endl;
-    } else {
+    // White is to move: take white and play on when the position after white's best move
+    // is not worse for white, otherwise swap and take black. Placing two more stones is not used
+    char gs[kRenjuAiMaxBoardSize * kRenjuAiMaxBoardSize] = {0};
+    for (int i = 0; i < move_count; ++i)
+        gs[g_board_size * moves[i][0] + moves[i][1]] = static_cast<char>(i % 2 == 0 ? 2 : 1);
+    engine->setPosition(gs);
+
+    int move_r, move_c;
+    if (!performMove(&move_r, &move_c)) {
         writeStdout("ERROR");
+        return;
+    }
+    if (engine->evaluate(1) >= 0) {
+        std::cout << move_c << "," << move_r << std::endl;
+        startPondering();
+        return;
+    }
+    engine->remove(move_r, move_c);
+
+    for (int i = 0; i < move_count; ++i)
+        gs[g_board_size * moves[i][0] + moves[i][1]] = static_cast<char>(i % 2 == 0 ? 1 : 2);
+    engine->setPosition(gs);
+    writeStdout("SWAP");
+}
+
+void RenjuProtocolGomocup::startPondering() {
+    if (!ponder.enabled) return;
+
+    ponder.stop = false;
+    ponder.done = false;
+    ponder.elapsed = 0;
+    ponder.found = false;
+    ponder.start = std::chrono::steady_clock::now();
+
+    // The engine is only used by the thread until it is joined,
+    // the result fields are read after that
+    ponder.thread = std::thread([] {
+        int predicted_r, predicted_c, actual_depth, move_r, move_c;
+        engine->ponder(1, num_threads, &ponder.stop,
+                       &predicted_r, &predicted_c, &actual_depth, &move_r, &move_c);
+
+        if (predicted_r >= 0 && move_r >= 0) {
+            ponder.found = true;
+            ponder.hash = engine->board().hashAfter(predicted_r, predicted_c, 2);
+            ponder.actual_depth = actual_depth;
+            ponder.move_r = move_r;
+            ponder.move_c = move_c;
+        }
+        ponder.done = !ponder.stop;
+    });
+}
+
+void RenjuProtocolGomocup::stopPondering() {
+    if (!ponder.thread.joinable()) return;
+
+    ponder.stop = true;
+    ponder.thread.join();
+    ponder.elapsed = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - ponder.start).count());
+}
+
+bool RenjuProtocolGomocup::ponderHit(int time_limit, int *actual_depth, int *move_r, int *move_c) {
+    // The opponent played the predicted reply
+    if (!ponder.found || ponder.hash != engine->board().hash()) return false;
+    ponder.found = false;
+
+    // Use the result only when it is at least as good as a search within time_limit;
+    // otherwise the search still starts from the warm transposition table
+    if (!ponder.done && ponder.elapsed < time_limit) return false;
+
+    *actual_depth = ponder.actual_depth;
+    *move_r = ponder.move_r;
+    *move_c = ponder.move_c;
+    return true;
+}
+
+void RenjuProtocolGomocup::handleInfo(const char *line) {
+    // [key] [value]
+    const char *value = strchr(line, ' ');
+    if (value == nullptr) return;
+    std::string key(line, value - line);
+    if (!time.setInfo(key.c_str(), atoll(value + 1))) return;
+
+    // Fit the transposition table in max_memory, never growing past -m
+    if (key == "max_memory") {
+        int size_mb = time.transpositionTableSize();
+        if (size_mb < 0) size_mb = tt_size;
+        else if (tt_size >= 0 && tt_size < size_mb) size_mb = tt_size;
+        if (size_mb >= 0) engine->setTranspositionTableSize(size_mb);
     }
 }
 
 void RenjuProtocolGomocup::splitLine(const char *line, int *output) {
     // Copy input
     size_t in_length = strlen(line);
-    char *_line = new char[in_length];
-    memcpy(_line, line, in_length);
+    char *_line = new char[in_length + 1];
+    memcpy(_line, line, in_length + 1);
 
     int pos = 0, seg_idx = 0, seg_begin = 0;
 
@@ -0,0 +1,69 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <protocols/gomocup_time.h>
+#include <algorithm>
+#include <cstring>
+
+RenjuProtocolGomocupTime::RenjuProtocolGomocupTime() :
+    timeout_turn(1000),
+    timeout_match(0),
+    time_left(-1),
+    max_memory(0) {}
+
+bool RenjuProtocolGomocupTime::setInfo(const char *key, long long value) {
+    if (strcmp(key, "timeout_turn") == 0) {
+        timeout_turn = std::max(0LL, value);
+    } else if (strcmp(key, "timeout_match") == 0) {
+        timeout_match = std::max(0LL, value);
+        if (timeout_match == 0) time_left = -1;
+        else if (time_left < 0) time_left = timeout_match;
+    } else if (strcmp(key, "time_left") == 0) {
+        time_left = std::max(0LL, value);
+    } else if (strcmp(key, "max_memory") == 0) {
+        max_memory = std::max(0LL, value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int RenjuProtocolGomocupTime::turnTimeLimit(int own_moves) const {
+    // Per-turn cap, keeping a margin that never eats more than a quarter of the turn
+    long long limit = timeout_turn - std::min(static_cast<long long>(kGomocupTimeMargin), timeout_turn / 4);
+
+    // Share of the remaining match time
+    if (timeout_match > 0 && time_left >= 0) {
+        int moves_left = std::max(kGomocupTimeExpectedMoves - own_moves, kGomocupTimeMinMovesLeft);
+        long long share = (time_left - kGomocupTimeMargin) / moves_left;
+        limit = std::min(limit, share);
+    }
+
+    return static_cast<int>(std::max(0LL, limit));
+}
+
+void RenjuProtocolGomocupTime::moveFinished(int elapsed) {
+    if (time_left < 0) return;
+    time_left = std::max(0LL, time_left - elapsed);
+}
+
+int RenjuProtocolGomocupTime::transpositionTableSize() const {
+    if (max_memory <= 0) return -1;
+    long long size_mb = static_cast<long long>(max_memory * kGomocupTimeMemoryRatio) >> 20;
+    return static_cast<int>(std::min(size_mb, 4096LL));
+}
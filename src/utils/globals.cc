@@ -20,8 +20,5 @@
 
 int g_board_size = 15;
 unsigned int g_gs_size = 225;
-unsigned int g_node_count = 0;
-unsigned int g_eval_count = 0;
-unsigned int g_pm_count = 0;
 unsigned int g_cc_0 = 0;
 unsigned int g_cc_1 = 0;
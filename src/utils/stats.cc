@@ -0,0 +1,93 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <utils/stats.h>
+
+#ifdef BLUPIG_STATS
+
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+static const char *const kCounterNames[kRenjuStatsCounterCount] = {
+    "eval_move", "eval_adm", "match_pattern", "measure_direction",
+    "heuristic_cache_hit", "heuristic_cache_miss", "move_gen", "move_gen_candidates",
+    "node", "tt_probe", "tt_hit", "beta_cutoff"
+};
+
+static const char *const kTimerNames[kRenjuStatsTimerCount] = {
+    "search", "iteration", "move_gen", "eval_move"
+};
+
+thread_local RenjuStats::Block *RenjuStats::thread_block = nullptr;
+
+// 所有计数过的线程的计数块
+static std::mutex g_stats_mutex;
+static std::vector<void *> *g_stats_blocks = new std::vector<void *>();
+
+RenjuStats::Block *RenjuStats::registerThread() {
+    void *memory = nullptr;
+    if (posix_memalign(&memory, alignof(Block), sizeof(Block)) != 0) throw std::bad_alloc();
+    Block *block = new (memory) Block();
+    for (auto &value : block->counts) value.store(0, std::memory_order_relaxed);
+    for (auto &value : block->timer_calls) value.store(0, std::memory_order_relaxed);
+    for (auto &value : block->timer_ns) value.store(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    g_stats_blocks->push_back(block);
+    return block;
+}
+
+void RenjuStats::reset() {
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    for (void *memory : *g_stats_blocks) {
+        Block *block = static_cast<Block *>(memory);
+        for (auto &value : block->counts) value.store(0, std::memory_order_relaxed);
+        for (auto &value : block->timer_calls) value.store(0, std::memory_order_relaxed);
+        for (auto &value : block->timer_ns) value.store(0, std::memory_order_relaxed);
+    }
+}
+
+nlohmann::json RenjuStats::toJson() {
+    uint64_t counts[kRenjuStatsCounterCount] = {0};
+    uint64_t timer_calls[kRenjuStatsTimerCount] = {0}, timer_ns[kRenjuStatsTimerCount] = {0};
+    {
+        std::lock_guard<std::mutex> lock(g_stats_mutex);
+        for (void *memory : *g_stats_blocks) {
+            Block *block = static_cast<Block *>(memory);
+            for (int i = 0; i < kRenjuStatsCounterCount; ++i)
+                counts[i] += block->counts[i].load(std::memory_order_relaxed);
+            for (int i = 0; i < kRenjuStatsTimerCount; ++i) {
+                timer_calls[i] += block->timer_calls[i].load(std::memory_order_relaxed);
+                timer_ns[i] += block->timer_ns[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    nlohmann::json result;
+    for (int i = 0; i < kRenjuStatsCounterCount; ++i) result["counters"][kCounterNames[i]] = counts[i];
+    for (int i = 0; i < kRenjuStatsTimerCount; ++i) {
+        result["timers"][kTimerNames[i]]["calls"] = timer_calls[i];
+        result["timers"][kTimerNames[i]]["ms"] = timer_ns[i] / 1e6;
+    }
+    return result;
+}
+
+#endif  // BLUPIG_STATS
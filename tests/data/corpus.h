@@ -0,0 +1,51 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TESTS_DATA_CORPUS_H_
+#define TESTS_DATA_CORPUS_H_
+
+#include <api/renju_api.h>
+
+// Fixed positions used by the benchmarks and the search regression harness
+struct RenjuCorpusPosition {
+    const char *name;
+    int board_size;
+    int state_format;   // RenjuAPIStateFormat
+    const char *state;
+    int player;         // Player to move
+    int search_depth;   // Fixed search depth used when benchmarking the search
+};
+
+static const RenjuCorpusPosition kRenjuCorpus[] = {
+    // The position searched by "gomoku test", recorded on a 19x19 board
+    {"test", 19, kRenjuAPIStateDigits,
+     "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+     "0000000000000000000000000000000000000000000000000000000000021210000000000000012111120000000000000221"
+     "2211000000000000121100220000000000000201020000000000000000020000000000000000010000000000000000000000"
+     "0000000000000000000000000000000000000000000000000000000000000",
+     2, 8},
+    {"opening", 15, kRenjuAPIStateMoves, "h8i9i8g8h9h7", 1, 6},
+    {"middle", 15, kRenjuAPIStateMoves, "h8i9i8g8h9h7j9h10g10f11j7k6i10", 2, 6},
+    {"attack", 15, kRenjuAPIStateMoves, "h8h9i9g7j10k11i7j8i10i8g10h10f10e10h11g12j11", 2, 6},
+    {"edge", 15, kRenjuAPIStateMoves, "a1b2c3b3c2d1b1a2e5c1d2e3", 1, 6},
+};
+
+static const int kRenjuCorpusSize = sizeof(kRenjuCorpus) / sizeof(kRenjuCorpus[0]);
+
+#endif  // TESTS_DATA_CORPUS_H_
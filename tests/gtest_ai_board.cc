@@ -0,0 +1,193 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <ai/board.h>
+#include <ai/eval.h>
+#include <ai/search_context.h>
+#include <cstdlib>
+#include <cstring>
+
+class RenjuAIBoardTest : public ::testing::Test {
+ protected:
+    RenjuAISearchContext ctx{15};
+
+    // Every cached heuristic value equals a fresh evaluation of the current board
+    void expectCacheConsistent() {
+        RenjuAISearchContext eval_ctx(15);
+        for (int r = 0; r < 15; ++r) {
+            for (int c = 0; c < 15; ++c) {
+                bool candidate = ctx.board.cell(r, c) == 0 &&
+                                 !RenjuAIUtils::remoteCell(ctx.board.data(), 15, r, c);
+                ASSERT_EQ(candidate, (ctx.board.candidateRow(r) >> c & 1) != 0);
+                if (ctx.board.cell(r, c) != 0) continue;
+                for (int player = 1; player <= 2; ++player) {
+                    ASSERT_EQ(RenjuAIEval::evalMove(&eval_ctx, ctx.board.data(), r, c, player),
+                              ctx.board.heuristic(&ctx, r, c, player));
+                }
+            }
+        }
+    }
+};
+
+TEST_F(RenjuAIBoardTest, makeUnmake) {
+    char gs[225] = {0};
+    gs[15 * 7 + 7] = 1; gs[15 * 7 + 8] = 2; gs[15 * 8 + 8] = 1;
+    ctx.board.load(gs);
+    uint64_t hash = ctx.board.hash();
+    expectCacheConsistent();
+
+    // Play a random line of moves, checking the cache after each make and unmake
+    srand(20170101);
+    int moves_r[40], moves_c[40];
+    for (int round = 0; round < 20; ++round) {
+        int n = rand() % 40 + 1;
+        for (int i = 0; i < n; ++i) {
+            do {
+                moves_r[i] = rand() % 15; moves_c[i] = rand() % 15;
+            } while (ctx.board.cell(moves_r[i], moves_c[i]) != 0);
+            ctx.board.make(moves_r[i], moves_c[i], i % 2 + 1);
+            if (i % 7 == 0) expectCacheConsistent();
+        }
+        expectCacheConsistent();
+        for (int i = n - 1; i >= 0; --i) {
+            ctx.board.unmake(moves_r[i], moves_c[i]);
+            if (i % 5 == 0) expectCacheConsistent();
+        }
+        EXPECT_EQ(0, memcmp(gs, ctx.board.data(), 225));
+        EXPECT_EQ(hash, ctx.board.hash());
+    }
+    EXPECT_NE(ctx.board.key(1), ctx.board.key(2));
+}
+
+TEST_F(RenjuAIBoardTest, placeRemove) {
+    // Game moves and takebacks may happen in any order and keep the board equal to a fresh load
+    char gs[225] = {0};
+    ctx.board.load(gs);
+    srand(20170103);
+    for (int round = 0; round < 300; ++round) {
+        int r = rand() % 15, c = rand() % 15;
+        if (ctx.board.cell(r, c) == 0) {
+            gs[15 * r + c] = static_cast<char>(rand() % 2 + 1);
+            ctx.board.place(r, c, gs[15 * r + c]);
+        } else {
+            gs[15 * r + c] = 0;
+            ctx.board.remove(r, c);
+        }
+        if (round % 30 == 0) expectCacheConsistent();
+    }
+    expectCacheConsistent();
+
+    RenjuAIBoard fresh(15);
+    fresh.load(gs);
+    EXPECT_EQ(0, memcmp(gs, ctx.board.data(), 225));
+    EXPECT_EQ(fresh.hash(), ctx.board.hash());
+    EXPECT_EQ(fresh.stoneCount(), ctx.board.stoneCount());
+
+    // The hash after a move is known before making it
+    if (ctx.board.cell(0, 0) != 0) ctx.board.remove(0, 0);
+    uint64_t expected = ctx.board.hashAfter(0, 0, 2);
+    ctx.board.make(0, 0, 2);
+    EXPECT_EQ(expected, ctx.board.hash());
+}
+
+TEST_F(RenjuAIBoardTest, hashBoardSizes) {
+    // Boards of different sizes never share hashes in the process-wide transposition table:
+    // neither empty boards, nor the same stones, nor a stone on the cell with the same index
+    RenjuAIBoard small(15), large(19);
+    EXPECT_NE(small.hash(), large.hash());
+
+    char gs_small[225] = {0}, gs_large[361] = {0};
+    gs_small[15 * 7 + 7] = 1; gs_large[19 * 7 + 7] = 1;
+    small.load(gs_small); large.load(gs_large);
+    EXPECT_NE(small.hash(), large.hash());
+
+    large.remove(7, 7);
+    large.place(5, 17, 1);
+    EXPECT_NE(small.hash(), large.hash());
+
+    // Incremental updates agree with a fresh load on the large board too
+    RenjuAIBoard fresh(19);
+    memset(gs_large, 0, sizeof(gs_large));
+    gs_large[19 * 5 + 17] = 1;
+    fresh.load(gs_large);
+    EXPECT_EQ(fresh.hash(), large.hash());
+}
+
+TEST_F(RenjuAIBoardTest, bitboards) {
+    // Bitboard queries agree with the char array helpers on random boards
+    char gs[400];
+    srand(20170102);
+    for (int round = 0; round < 300; ++round) {
+        int board_size = round % 2 == 0 ? 15 : 20;
+        RenjuAIBoard board(board_size);
+        RenjuAISearchContext eval_ctx(board_size);
+        int density = round % 10 + 1;
+        for (int i = 0; i < board_size * board_size; ++i) gs[i] = rand() % 40 < density ? rand() % 2 + 1 : 0;
+        board.load(gs);
+
+        for (int r = 0; r < board_size; ++r) {
+            for (int c = 0; c < board_size; ++c) {
+                EXPECT_EQ(RenjuAIUtils::remoteCell(gs, board_size, r, c), board.remote(r, c));
+
+                // Candidates are exactly the empty cells with a stone within two cells
+                bool candidate = gs[board_size * r + c] == 0 && !RenjuAIUtils::remoteCell(gs, board_size, r, c);
+                EXPECT_EQ(candidate, (board.candidateRow(r) >> c & 1) != 0);
+
+                if (gs[board_size * r + c] == 0) {
+                    int player = (r + c) % 2 + 1;
+                    ASSERT_EQ(RenjuAIEval::evalMove(&eval_ctx, gs, r, c, player),
+                              RenjuAIEval::evalMove(&eval_ctx, board, r, c, player));
+                }
+            }
+        }
+
+        // The char array scan reports whichever five it meets first, so compare only
+        // boards where at most one player has five
+        if (!(board.hasFive(1) && board.hasFive(2))) {
+            EXPECT_EQ(RenjuAIEval::winningPlayer(&eval_ctx, gs), board.winningPlayer());
+        }
+    }
+}
+
+TEST_F(RenjuAIBoardTest, fiveAt) {
+    // A stone at (r, c) makes five exactly when a consecutive measurement through it reaches five
+    char gs[225];
+    srand(20170103);
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 225; ++i) gs[i] = rand() % 3 != 0 ? rand() % 2 + 1 : 0;
+        ctx.board.load(gs);
+        for (int r = 0; r < 15; ++r) {
+            for (int c = 0; c < 15; ++c) {
+                if (gs[15 * r + c] != 0) continue;
+                for (int player = 1; player <= 2; ++player) {
+                    gs[15 * r + c] = static_cast<char>(player);
+                    bool five = false;
+                    for (int d = 0; d < 4; ++d) {
+                        RenjuAIEval::DirectionMeasurement dm;
+                        RenjuAIEval::measureDirection(&ctx, gs, r, c, RenjuAIEval::line_directions[d][0],
+                                                      RenjuAIEval::line_directions[d][1], player, true, &dm);
+                        if (dm.length >= 5) five = true;
+                    }
+                    gs[15 * r + c] = 0;
+                    ASSERT_EQ(five, ctx.board.fiveAt(r, c, player));
+                }
+            }
+        }
+    }
+}
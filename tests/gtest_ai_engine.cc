@@ -0,0 +1,66 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <ai/engine.h>
+#include <cstring>
+
+TEST(RenjuAIEngineTest, incrementalPosition) {
+    // The same position reached move by move, with a takeback, or through setPosition
+    // searches identically: the incremental caches hold the same values as a fresh board
+    static const int moves[][2] = {{7, 7}, {7, 8}, {8, 8}, {6, 6}, {8, 7}, {9, 9}, {6, 8}, {8, 6}, {5, 9}};
+    char gs[225] = {0};
+
+    RenjuAIEngine incremental(15), fresh(15);
+    incremental.setTranspositionTableSize(1);
+    fresh.setTranspositionTableSize(1);
+    for (int i = 0; i < 9; ++i) {
+        ASSERT_TRUE(incremental.play(moves[i][0], moves[i][1], i % 2 + 1));
+        gs[15 * moves[i][0] + moves[i][1]] = static_cast<char>(i % 2 + 1);
+    }
+    EXPECT_FALSE(incremental.play(7, 7, 2));
+    ASSERT_TRUE(incremental.play(0, 0, 2));
+    ASSERT_TRUE(incremental.remove(0, 0));
+    EXPECT_FALSE(incremental.remove(0, 0));
+
+    // Searching on the persistent board leaves it unchanged
+    int r0, c0, d0, r1, c1, d1, winning_player;
+    incremental.generateMove(2, 4, 0, 1, &d0, &r0, &c0, &winning_player);
+    EXPECT_EQ(0, memcmp(gs, incremental.board().data(), 225));
+
+    fresh.setPosition(gs);
+    fresh.generateMove(2, 4, 0, 1, &d1, &r1, &c1, &winning_player);
+    EXPECT_EQ(r0, r1); EXPECT_EQ(c0, c1); EXPECT_EQ(4, d1);
+    EXPECT_EQ(0, winning_player);
+
+    // The principal variation starts with the generated move and alternates between empty cells
+    const std::vector<RenjuAIMove> &pv = fresh.principalVariation();
+    ASSERT_GE(pv.size(), 1u);
+    EXPECT_EQ(r1, pv[0].r); EXPECT_EQ(c1, pv[0].c);
+    for (size_t i = 0; i < pv.size(); ++i) EXPECT_EQ(0, gs[15 * pv[i].r + pv[i].c]);
+
+    // setPosition only applies the differences
+    gs[15 * 7 + 7] = 0; gs[15 * 0 + 14] = 1;
+    fresh.setPosition(gs);
+    EXPECT_EQ(0, memcmp(gs, fresh.board().data(), 225));
+    EXPECT_EQ(9, fresh.board().stoneCount());
+
+    // A new game clears the board
+    fresh.reset(15);
+    EXPECT_EQ(0, fresh.board().stoneCount());
+}
@@ -19,96 +19,98 @@
 #include <gtest/gtest.h>
 #include <ai/eval.h>
 #include <ai/utils.h>
+#include <cstdlib>
 
 class RenjuAIEvalTest : public ::testing::Test {
  protected:
+    RenjuAISearchContext ctx{15};
     char gs[361] = {0};
 };
 
 TEST_F(RenjuAIEvalTest, winningPlayer) {
-    EXPECT_EQ(0, RenjuAIEval::winningPlayer(gs));
+    EXPECT_EQ(0, RenjuAIEval::winningPlayer(&ctx, gs));
 
     gs[2] = 1; gs[3] = 1; gs[4] = 1; gs[5] = 1;
-    EXPECT_EQ(0, RenjuAIEval::winningPlayer(gs));
+    EXPECT_EQ(0, RenjuAIEval::winningPlayer(&ctx, gs));
 
     gs[6] = 1;
-    EXPECT_EQ(1, RenjuAIEval::winningPlayer(gs));
+    EXPECT_EQ(1, RenjuAIEval::winningPlayer(&ctx, gs));
 
     gs[7] = 1;
-    EXPECT_EQ(1, RenjuAIEval::winningPlayer(gs));
+    EXPECT_EQ(1, RenjuAIEval::winningPlayer(&ctx, gs));
 
     memset(gs, 0, 361);
 
     gs[2] = 1; gs[3] = 2; gs[4] = 2; gs[5] = 2; gs[6] = 2; gs[7] = 2;
-    EXPECT_EQ(2, RenjuAIEval::winningPlayer(gs));
+    EXPECT_EQ(2, RenjuAIEval::winningPlayer(&ctx, gs));
 }
 
 TEST_F(RenjuAIEvalTest, meausreDirection) {
     RenjuAIEval::DirectionMeasurement dm;
-    RenjuAIEval::measureDirection(gs, 0, 0, 1, 1, 1, true, &dm);
+    RenjuAIEval::measureDirection(&ctx, gs, 0, 0, 1, 1, 1, true, &dm);
     EXPECT_EQ(1, dm.length); EXPECT_EQ(1, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
     // * 0 0
     // 0 1 0
     // 0 0 0
-    RenjuAIUtils::setCell(gs, 1, 1, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 1, 1);
     gs[1 * 15 + 1] = 1;
-    RenjuAIEval::measureDirection(gs, 0, 0, 1, 1, 1, true, &dm);
+    RenjuAIEval::measureDirection(&ctx, gs, 0, 0, 1, 1, 1, true, &dm);
     EXPECT_EQ(2, dm.length); EXPECT_EQ(1, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
     // * 0 0 0
     // 0 1 0 0
     // 0 0 1 0
     // 0 0 0 0
-    RenjuAIUtils::setCell(gs, 2, 2, 1);
-    RenjuAIEval::measureDirection(gs, 0, 0, 1, 1, 1, true, &dm);
+    RenjuAIUtils::setCell(gs, 15, 2, 2, 1);
+    RenjuAIEval::measureDirection(&ctx, gs, 0, 0, 1, 1, 1, true, &dm);
     EXPECT_EQ(3, dm.length); EXPECT_EQ(1, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
     // * 0 0 0
     // 0 1 0 0
     // 0 0 1 0
     // 0 0 0 2
-    RenjuAIUtils::setCell(gs, 3, 3, 2);
-    RenjuAIEval::measureDirection(gs, 0, 0, 1, 1, 1, true, &dm);
+    RenjuAIUtils::setCell(gs, 15, 3, 3, 2);
+    RenjuAIEval::measureDirection(&ctx, gs, 0, 0, 1, 1, 1, true, &dm);
     EXPECT_EQ(3, dm.length); EXPECT_EQ(2, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
     // * 0 0 0
     // 0 1 0 0
     // 0 0 0 0
     // 0 0 0 1
-    RenjuAIUtils::setCell(gs, 2, 2, 0);
-    RenjuAIUtils::setCell(gs, 3, 3, 1);
-    RenjuAIEval::measureDirection(gs, 0, 0, 1, 1, 1, true, &dm);
+    RenjuAIUtils::setCell(gs, 15, 2, 2, 0);
+    RenjuAIUtils::setCell(gs, 15, 3, 3, 1);
+    RenjuAIEval::measureDirection(&ctx, gs, 0, 0, 1, 1, 1, true, &dm);
     EXPECT_EQ(2, dm.length); EXPECT_EQ(1, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
-    RenjuAIEval::measureDirection(gs, 0, 0, 1, 1, 1, false, &dm);
+    RenjuAIEval::measureDirection(&ctx, gs, 0, 0, 1, 1, 1, false, &dm);
     EXPECT_EQ(3, dm.length); EXPECT_EQ(1, dm.block_count); EXPECT_EQ(1, dm.space_count);
 
     // 0 0 0 0 0
     // 0 1 * 1 0
     // 0 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 1, 1);
-    RenjuAIUtils::setCell(gs, 1, 3, 1);
-    RenjuAIEval::measureDirection(gs, 1, 2, 0, 1, 1, true, &dm);
+    RenjuAIUtils::setCell(gs, 15, 1, 1, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 3, 1);
+    RenjuAIEval::measureDirection(&ctx, gs, 1, 2, 0, 1, 1, true, &dm);
     EXPECT_EQ(3, dm.length); EXPECT_EQ(0, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
-    RenjuAIEval::measureDirection(gs, 1, 2, 0, 1, 1, false, &dm);
+    RenjuAIEval::measureDirection(&ctx, gs, 1, 2, 0, 1, 1, false, &dm);
     EXPECT_EQ(3, dm.length); EXPECT_EQ(0, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
     // 0 0 0 0 0 0
     // 1 1 * 1 0 0
     // 0 0 0 0 0 0
-    RenjuAIUtils::setCell(gs, 1, 0, 1);
-    RenjuAIEval::measureDirection(gs, 1, 2, 0, 1, 1, true, &dm);
+    RenjuAIUtils::setCell(gs, 15, 1, 0, 1);
+    RenjuAIEval::measureDirection(&ctx, gs, 1, 2, 0, 1, 1, true, &dm);
     EXPECT_EQ(4, dm.length); EXPECT_EQ(1, dm.block_count); EXPECT_EQ(0, dm.space_count);
 
     // 0 0 0 0 0 0 0
     // 0 1 * 1 0 1 0
     // 0 0 0 0 0 0 0
-    RenjuAIUtils::setCell(gs, 1, 0, 0);
-    RenjuAIUtils::setCell(gs, 1, 5, 1);
-    RenjuAIEval::measureDirection(gs, 1, 2, 0, 1, 1, false, &dm);
+    RenjuAIUtils::setCell(gs, 15, 1, 0, 0);
+    RenjuAIUtils::setCell(gs, 15, 1, 5, 1);
+    RenjuAIEval::measureDirection(&ctx, gs, 1, 2, 0, 1, 1, false, &dm);
     EXPECT_EQ(4, dm.length); EXPECT_EQ(0, dm.block_count); EXPECT_EQ(1, dm.space_count);
 }
 
@@ -117,7 +119,7 @@ TEST_F(RenjuAIEvalTest, meausreAllDirections) {
 
     // * 0
     // 0 0
-    RenjuAIEval::measureAllDirections(gs, 0, 0, 1, true, adm);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 0, 0, 1, true, adm);
     EXPECT_EQ(1, adm[0].length); EXPECT_EQ(1, adm[1].length); EXPECT_EQ(1, adm[2].length); EXPECT_EQ(1, adm[3].length);
     EXPECT_EQ(1, adm[0].block_count); EXPECT_EQ(1, adm[1].block_count); EXPECT_EQ(1, adm[2].block_count); EXPECT_EQ(2, adm[3].block_count);
     EXPECT_EQ(0, adm[0].space_count); EXPECT_EQ(0, adm[1].space_count); EXPECT_EQ(0, adm[2].space_count); EXPECT_EQ(0, adm[3].space_count);
@@ -125,7 +127,7 @@ TEST_F(RenjuAIEvalTest, meausreAllDirections) {
     // 0 0 0
     // * 0 0
     // 0 0 0
-    RenjuAIEval::measureAllDirections(gs, 1, 0, 1, true, adm);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 1, 0, 1, true, adm);
     EXPECT_EQ(1, adm[0].length); EXPECT_EQ(1, adm[1].length); EXPECT_EQ(1, adm[2].length); EXPECT_EQ(1, adm[3].length);
     EXPECT_EQ(1, adm[0].block_count); EXPECT_EQ(1, adm[1].block_count); EXPECT_EQ(0, adm[2].block_count); EXPECT_EQ(1, adm[3].block_count);
     EXPECT_EQ(0, adm[0].space_count); EXPECT_EQ(0, adm[1].space_count); EXPECT_EQ(0, adm[2].space_count); EXPECT_EQ(0, adm[3].space_count);
@@ -133,8 +135,8 @@ TEST_F(RenjuAIEvalTest, meausreAllDirections) {
     // 0 0 0
     // * 1 0
     // 0 0 0
-    RenjuAIUtils::setCell(gs, 1, 1, 1);
-    RenjuAIEval::measureAllDirections(gs, 1, 0, 1, true, adm);
+    RenjuAIUtils::setCell(gs, 15, 1, 1, 1);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 1, 0, 1, true, adm);
     EXPECT_EQ(2, adm[0].length); EXPECT_EQ(1, adm[1].length); EXPECT_EQ(1, adm[2].length); EXPECT_EQ(1, adm[3].length);
     EXPECT_EQ(1, adm[0].block_count); EXPECT_EQ(1, adm[1].block_count); EXPECT_EQ(0, adm[2].block_count); EXPECT_EQ(1, adm[3].block_count);
     EXPECT_EQ(0, adm[0].space_count); EXPECT_EQ(0, adm[1].space_count); EXPECT_EQ(0, adm[2].space_count); EXPECT_EQ(0, adm[3].space_count);
@@ -145,22 +147,62 @@ TEST_F(RenjuAIEvalTest, meausreAllDirections) {
     // 0 2 0
     // 0 * 0
     // 0 0 0
-    RenjuAIUtils::setCell(gs, 1, 1, 2);
-    RenjuAIUtils::setCell(gs, 2, 1, 2);
-    RenjuAIUtils::setCell(gs, 3, 1, 2);
-    RenjuAIEval::measureAllDirections(gs, 4, 1, 2, true, adm);
+    RenjuAIUtils::setCell(gs, 15, 1, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 2, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 3, 1, 2);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 4, 1, 2, true, adm);
     EXPECT_EQ(1, adm[0].length); EXPECT_EQ(1, adm[1].length); EXPECT_EQ(4, adm[2].length); EXPECT_EQ(1, adm[3].length);
     EXPECT_EQ(0, adm[0].block_count); EXPECT_EQ(0, adm[1].block_count); EXPECT_EQ(0, adm[2].block_count); EXPECT_EQ(0, adm[3].block_count);
     EXPECT_EQ(0, adm[0].space_count); EXPECT_EQ(0, adm[1].space_count); EXPECT_EQ(0, adm[2].space_count); EXPECT_EQ(0, adm[3].space_count);
 }
 
-TEST_F(RenjuAIEvalTest, matchPattern) {
+TEST_F(RenjuAIEvalTest, lookupAllDirections) {
+    RenjuAIEval::DirectionMeasurement adm[4], adm_consecutive[4], expected[4];
+
+    // Random dense boards exercise edges, gaps and the out-of-window fallback
+    srand(20160921);
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 225; ++i) gs[i] = rand() % 4 == 0 ? 0 : rand() % 3;
+        for (int r = 0; r < 15; ++r) {
+            for (int c = 0; c < 15; ++c) {
+                int player = (r + c + round) % 2 + 1;
+                RenjuAIEval::lookupAllDirections(&ctx, gs, r, c, player, adm, adm_consecutive);
+                for (int consecutive = 0; consecutive < 2; ++consecutive) {
+                    RenjuAIEval::DirectionMeasurement *actual = consecutive ? adm_consecutive : adm;
+                    RenjuAIEval::measureAllDirections(&ctx, gs, r, c, player, consecutive != 0, expected);
+                    for (int d = 0; d < 4; ++d) {
+                        ASSERT_EQ(expected[d].length, actual[d].length);
+                        ASSERT_EQ(expected[d].block_count, actual[d].block_count);
+                        ASSERT_EQ(expected[d].space_count, actual[d].space_count);
+                    }
+                }
+            }
+        }
+    }
+}
 
-    RenjuAIEval::DirectionPattern *preset_patterns = nullptr;
-    int *preset_scores = nullptr;
-    int preset_patterns_size = 0;
-    int preset_patterns_skip[6] = {0};
-    RenjuAIEval::generatePresetPatterns(&preset_patterns, &preset_scores, &preset_patterns_size, preset_patterns_skip);
+TEST_F(RenjuAIEvalTest, evalADM) {
+    // Every combination of measurements that measureDirection can produce scores the same
+    // through the class table as through pattern matching
+    RenjuAIEval::DirectionMeasurement dms[30], adm[4];
+    int n = 0;
+    for (int i = 0; i < 30; ++i) {
+        RenjuAIEval::DirectionMeasurement dm = {static_cast<char>(i / 6 + 1), static_cast<char>(i / 2 % 3), static_cast<char>(i % 2)};
+        if (dm.length == 1 && dm.space_count != 0) continue;
+        if (dm.length == 5 && (dm.block_count != 0 || dm.space_count != 0)) continue;
+        dms[n++] = dm;
+    }
+    for (int a = 0; a < n; ++a)
+        for (int b = 0; b < n; ++b)
+            for (int c = 0; c < n; ++c)
+                for (int d = 0; d < n; ++d) {
+                    adm[0] = dms[a]; adm[1] = dms[b]; adm[2] = dms[c]; adm[3] = dms[d];
+                    ASSERT_EQ(RenjuAIEval::scoreADM(adm), RenjuAIEval::evalADM(&ctx, adm));
+                }
+}
+
+TEST_F(RenjuAIEvalTest, matchPattern) {
+    const RenjuAIEval::DirectionPattern *preset_patterns = RenjuAIEval::preset_patterns;
 
     RenjuAIEval::DirectionMeasurement adm[4];
 
@@ -171,11 +213,11 @@ TEST_F(RenjuAIEvalTest, matchPattern) {
     // 0 * 0
     // 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 1, 2);
-    RenjuAIUtils::setCell(gs, 2, 1, 2);
-    RenjuAIUtils::setCell(gs, 3, 1, 2);
-    RenjuAIEval::measureAllDirections(gs, 4, 1, 2, true, adm);
-    EXPECT_EQ(1, RenjuAIEval::matchPattern(adm, &preset_patterns[2]));
+    RenjuAIUtils::setCell(gs, 15, 1, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 2, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 3, 1, 2);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 4, 1, 2, true, adm);
+    EXPECT_EQ(1, RenjuAIEval::matchPattern(&ctx, adm, &preset_patterns[2]));
 
     // 0 0 0 0
     // 0 * 2 2
@@ -184,12 +226,12 @@ TEST_F(RenjuAIEvalTest, matchPattern) {
     // 0 2 0 0
     // 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 2, 2);
-    RenjuAIUtils::setCell(gs, 1, 3, 2);
-    RenjuAIUtils::setCell(gs, 2, 1, 2);
-    RenjuAIUtils::setCell(gs, 4, 1, 2);
-    RenjuAIEval::measureAllDirections(gs, 1, 1, 2, false, adm);
-    EXPECT_EQ(1, RenjuAIEval::matchPattern(adm, &preset_patterns[14]));
+    RenjuAIUtils::setCell(gs, 15, 1, 2, 2);
+    RenjuAIUtils::setCell(gs, 15, 1, 3, 2);
+    RenjuAIUtils::setCell(gs, 15, 2, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 4, 1, 2);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 1, 1, 2, false, adm);
+    EXPECT_EQ(1, RenjuAIEval::matchPattern(&ctx, adm, &preset_patterns[14]));
 
     // 0 0 0 0 0
     // 0 * 2 2 0
@@ -198,12 +240,12 @@ TEST_F(RenjuAIEvalTest, matchPattern) {
     // 0 0 0 0 0
     // 0 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 2, 2);
-    RenjuAIUtils::setCell(gs, 1, 3, 2);
-    RenjuAIUtils::setCell(gs, 2, 2, 2);
-    RenjuAIUtils::setCell(gs, 3, 3, 2);
-    RenjuAIEval::measureAllDirections(gs, 1, 1, 2, false, adm);
-    EXPECT_EQ(1, RenjuAIEval::matchPattern(adm, &preset_patterns[14]));
+    RenjuAIUtils::setCell(gs, 15, 1, 2, 2);
+    RenjuAIUtils::setCell(gs, 15, 1, 3, 2);
+    RenjuAIUtils::setCell(gs, 15, 2, 2, 2);
+    RenjuAIUtils::setCell(gs, 15, 3, 3, 2);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 1, 1, 2, false, adm);
+    EXPECT_EQ(1, RenjuAIEval::matchPattern(&ctx, adm, &preset_patterns[14]));
 
     // 0 0 0 0 0 0
     // 0 * 2 0 2 0
@@ -212,14 +254,14 @@ TEST_F(RenjuAIEvalTest, matchPattern) {
     // 0 2 0 0 0 0
     // 0 1 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 2, 2);
-    RenjuAIUtils::setCell(gs, 1, 4, 2);
-    RenjuAIUtils::setCell(gs, 2, 1, 2);
-    RenjuAIUtils::setCell(gs, 3, 1, 2);
-    RenjuAIUtils::setCell(gs, 4, 1, 2);
-    RenjuAIUtils::setCell(gs, 5, 1, 1);
-    RenjuAIEval::measureAllDirections(gs, 1, 1, 2, false, adm);
-    EXPECT_EQ(1, RenjuAIEval::matchPattern(adm, &preset_patterns[10]));
+    RenjuAIUtils::setCell(gs, 15, 1, 2, 2);
+    RenjuAIUtils::setCell(gs, 15, 1, 4, 2);
+    RenjuAIUtils::setCell(gs, 15, 2, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 3, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 4, 1, 2);
+    RenjuAIUtils::setCell(gs, 15, 5, 1, 1);
+    RenjuAIEval::measureAllDirections(&ctx, gs, 1, 1, 2, false, adm);
+    EXPECT_EQ(1, RenjuAIEval::matchPattern(&ctx, adm, &preset_patterns[10]));
 }
 
 TEST_F(RenjuAIEvalTest, evalMove) {
@@ -228,39 +270,39 @@ TEST_F(RenjuAIEvalTest, evalMove) {
     // 0 * 1 1 1 1 2
     // 0 0 0 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 2, 1);
-    RenjuAIUtils::setCell(gs, 1, 3, 1);
-    RenjuAIUtils::setCell(gs, 1, 4, 1);
-    RenjuAIUtils::setCell(gs, 1, 5, 1);
-    RenjuAIUtils::setCell(gs, 1, 6, 2);
-    EXPECT_EQ(10004, RenjuAIEval::evalMove(gs, 1, 1, 1));
+    RenjuAIUtils::setCell(gs, 15, 1, 2, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 3, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 4, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 5, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 6, 2);
+    EXPECT_EQ(10004, RenjuAIEval::evalMove(&ctx, gs, 1, 1, 1));
 
     // 0 0 0 0 0 0 0 0
     // 0 1 1 * 1 1 1 0
     // 0 0 0 0 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 1, 1);
-    RenjuAIUtils::setCell(gs, 1, 2, 1);
-    RenjuAIUtils::setCell(gs, 1, 4, 1);
-    RenjuAIUtils::setCell(gs, 1, 5, 1);
-    RenjuAIUtils::setCell(gs, 1, 6, 1);
-    EXPECT_EQ(10004, RenjuAIEval::evalMove(gs, 1, 3, 1));
+    RenjuAIUtils::setCell(gs, 15, 1, 1, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 2, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 4, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 5, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 6, 1);
+    EXPECT_EQ(10004, RenjuAIEval::evalMove(&ctx, gs, 1, 3, 1));
 
     // 0 0 0 0 0 0
     // 0 * 1 1 1 0
     // 0 0 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 2, 1);
-    RenjuAIUtils::setCell(gs, 1, 3, 1);
-    RenjuAIUtils::setCell(gs, 1, 4, 1);
-    EXPECT_EQ(703, RenjuAIEval::evalMove(gs, 1, 1, 1));
+    RenjuAIUtils::setCell(gs, 15, 1, 2, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 3, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 4, 1);
+    EXPECT_EQ(703, RenjuAIEval::evalMove(&ctx, gs, 1, 1, 1));
 
     // 0 0 0 0 0 0
     // 0 1 * 1 1 0
     // 0 0 0 0 0 0
     memset(gs, 0, 361);
-    RenjuAIUtils::setCell(gs, 1, 1, 1);
-    RenjuAIUtils::setCell(gs, 1, 3, 1);
-    RenjuAIUtils::setCell(gs, 1, 4, 1);
-    EXPECT_EQ(703, RenjuAIEval::evalMove(gs, 1, 2, 1));
+    RenjuAIUtils::setCell(gs, 15, 1, 1, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 3, 1);
+    RenjuAIUtils::setCell(gs, 15, 1, 4, 1);
+    EXPECT_EQ(703, RenjuAIEval::evalMove(&ctx, gs, 1, 2, 1));
 }
@@ -17,11 +17,29 @@
  */
 
 #include <gtest/gtest.h>
+#include <ai/ai_controller.h>
 #include <ai/negamax.h>
 #include <api/renju_api.h>
+#include <utils/globals.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 class RenjuAINegamaxTest : public ::testing::Test {
  protected:
+    // Test positions are recorded on a 19x19 board, RenjuAPI::gsFromString
+    // checks the length against the global board size
+    void SetUp() override {
+        g_board_size = 19;
+        g_gs_size = 361;
+    }
+
+    void TearDown() override {
+        g_board_size = 15;
+        g_gs_size = 225;
+    }
+
+    RenjuAISearchContext ctx{19};
     char gs[361] = {0};
     char gs_string[362] = {0};
 };
@@ -32,32 +50,32 @@ TEST_F(RenjuAINegamaxTest, heuristicNegamax0) {
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000200100000000000000122200000000000000011200000000000000001210000000000000000200200000000000000110000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000200100000000000000122221000000000000011220000000000000001210000000000000001200200000000000011112000000000000002000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000100000000000000000220000000000002111122000000000000001121200000000000000211020000000000000002021000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000100000000000000000020000000000000100112100000000000001222210000000000000020122000000000000000101200000000000000000002000000000000000000010000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000110000000000000000020000000000000000022200000000000000120200010000000000020102120000000000010121210000000000000100211000000000000000000200000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 1, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 }
 
@@ -67,37 +85,221 @@ TEST_F(RenjuAINegamaxTest, heuristicNegamax1) {
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000100100000000000000121111200000000000002020000000000000000022100000000000000000200000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001211100000000000000111200000000000000021220000000000000002000000000000000000200000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001110000000000000000120000000000000000122200000000000000021112000000000000000000000000000000000002000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001010000000000000000120000000000000002122211000000000001021112000000000000020101000000000000010202000000000000000002000000000000000002210000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, false, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 
     memcpy(gs_string, "1000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000010000000000000000020000000000000002120000000000000000220000000000000000010200000000000000000001000000000000000000000000010000000000000000000000000000000000000000000000000000000000000000010000000000000000000000000000000000000000000000000000", 362);
     RenjuAPI::gsFromString(gs_string, gs);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, true,  nullptr, &move_r0, &move_c0);
-    RenjuAINegamax::heuristicNegamax(gs, 2, 4, 0, false, nullptr, &move_r1, &move_c1);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, true,  nullptr, &move_r0, &move_c0);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, 4, false, nullptr, &move_r1, &move_c1);
+    EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
+}
+
+TEST_F(RenjuAINegamaxTest, heuristicNegamaxThreads) {
+
+    int move_r = -1, move_c = -1;
+
+    // Helper threads only share the transposition table, the result must still be a legal move
+    memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000200100000000000000122200000000000000011200000000000000001210000000000000000200200000000000000110000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
+    RenjuAPI::gsFromString(gs_string, gs);
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 4, true, nullptr, &move_r, &move_c, 4);
+    ASSERT_TRUE(move_r >= 0 && move_r < 19 && move_c >= 0 && move_c < 19);
+    EXPECT_EQ(0, gs[19 * move_r + move_c]);
+}
+
+TEST_F(RenjuAINegamaxTest, heuristicNegamaxContexts) {
+
+    // Independent searches in one process: each context has its own counters and table
+    memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000200100000000000000122200000000000000011200000000000000001210000000000000000200200000000000000110000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
+    RenjuAPI::gsFromString(gs_string, gs);
+
+    RenjuAITranspositionTable tts[3];
+    RenjuAISearchContext ctxs[3] = {RenjuAISearchContext(19), RenjuAISearchContext(19), RenjuAISearchContext(19)};
+    int moves[3][2];
+    for (int i = 0; i < 3; ++i) {
+        tts[i].resize(1);
+        ctxs[i].transposition_table = &tts[i];
+    }
+
+    RenjuAINegamax::heuristicNegamax(&ctxs[0], gs, 1, 4, true, nullptr, &moves[0][0], &moves[0][1]);
+
+    std::thread threads[2];
+    for (int i = 1; i < 3; ++i) {
+        threads[i - 1] = std::thread([&, i] {
+            RenjuAINegamax::heuristicNegamax(&ctxs[i], gs, 1, 4, true, nullptr, &moves[i][0], &moves[i][1]);
+        });
+    }
+    threads[0].join(); threads[1].join();
+
+    for (int i = 1; i < 3; ++i) {
+        EXPECT_EQ(moves[0][0], moves[i][0]); EXPECT_EQ(moves[0][1], moves[i][1]);
+        EXPECT_EQ(ctxs[0].node_count, ctxs[i].node_count);
+        EXPECT_EQ(ctxs[0].eval_count, ctxs[i].eval_count);
+    }
+}
+
+TEST_F(RenjuAINegamaxTest, sharedTableResize) {
+
+    // The shared table keeps its size while a search is using it
+    RenjuAISearchContext own(19);
+    RenjuAITranspositionTable tt;
+    own.transposition_table = &tt;
+    {
+        RenjuAINegamax::SharedTableUse use(&ctx);
+        RenjuAINegamax::SharedTableUse unrelated(&own);
+        EXPECT_FALSE(RenjuAINegamax::setTranspositionTableSize(1));
+        EXPECT_FALSE(RenjuAPI::setTranspositionTableSize(1));
+    }
+    {
+        // Without a context, e.g. for a whole batch of searches
+        RenjuAINegamax::SharedTableUse batch;
+        EXPECT_FALSE(RenjuAINegamax::setTranspositionTableSize(1));
+    }
+    {
+        RenjuAINegamax::SharedTableUse unrelated(&own);
+        EXPECT_TRUE(RenjuAINegamax::setTranspositionTableSize(1));
+    }
+    EXPECT_TRUE(RenjuAPI::setTranspositionTableSize(kRenjuAiTTDefaultSizeMB));
+}
+
+TEST_F(RenjuAINegamaxTest, heuristicNegamaxTimeLimit) {
+
+    memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000200100000000000000122221000000000000011220000000000000001210000000000000001200200000000000011112000000000000002000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
+    RenjuAPI::gsFromString(gs_string, gs);
+
+    // The hard deadline aborts the first iteration in progress, a legal move is still returned
+    for (int time_limit = 0; time_limit <= 20; time_limit += 5) {
+        int move_r = -1, move_c = -1, actual_depth = 0;
+        ctx.time_limit = time_limit;
+        auto start = std::chrono::steady_clock::now();
+        RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, -1, true, &actual_depth, &move_r, &move_c);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        EXPECT_LT(elapsed, time_limit + 200);
+        EXPECT_GE(actual_depth, 6);
+        ASSERT_TRUE(move_r >= 0 && move_r < 19 && move_c >= 0 && move_c < 19);
+        EXPECT_EQ(0, gs[19 * move_r + move_c]);
+    }
+
+    // Fixed-depth searches ignore the time budget
+    int move_r0, move_c0, move_r1, move_c1;
+    ctx.time_limit = 0;
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 6, true, nullptr, &move_r0, &move_c0);
+    EXPECT_FALSE(ctx.aborted);
+    ctx.time_limit = 100000;
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 1, 6, true, nullptr, &move_r1, &move_c1);
     EXPECT_EQ(move_r0, move_r1); EXPECT_EQ(move_c0, move_c1);
 }
+
+TEST_F(RenjuAINegamaxTest, iterationStats) {
+
+    // The position searched by "gomoku test"
+    memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000002121000000000000001211112000000000000022122110000000000001211002200000000000002010200000000000000000200000000000000000100000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
+    RenjuAPI::gsFromString(gs_string, gs);
+
+    // Every completed iteration is recorded, the last one gives the returned move
+    int move_r = -1, move_c = -1, actual_depth = 0;
+    ctx.node_limit = 30000;
+    RenjuAINegamax::heuristicNegamax(&ctx, gs, 2, -1, true, &actual_depth, &move_r, &move_c);
+    ctx.node_limit = 0;
+
+    ASSERT_GE(ctx.iterations.size(), 1u);
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < ctx.iterations.size(); ++i) {
+        const RenjuAIIterationStats &stats = ctx.iterations[i];
+        EXPECT_EQ(6 + 2 * static_cast<int>(i), stats.depth);
+        EXPECT_GT(stats.branching_factor, 1.0);
+        EXPECT_TRUE(stats.beta_cutoff_rate >= 0 && stats.beta_cutoff_rate <= 1);
+        EXPECT_TRUE(stats.first_move_cutoff_rate >= 0 && stats.first_move_cutoff_rate <= 1);
+        EXPECT_TRUE(stats.tt_hit_rate >= 0 && stats.tt_hit_rate <= 1);
+        ASSERT_GE(stats.pv.size(), 1u);
+        EXPECT_LE(static_cast<int>(stats.pv.size()), stats.depth);
+        EXPECT_EQ(stats.move_r, stats.pv[0].r); EXPECT_EQ(stats.move_c, stats.pv[0].c);
+        nodes += stats.node_count;
+    }
+    EXPECT_LE(nodes, ctx.node_count);
+    if (!ctx.aborted) {
+        EXPECT_EQ(actual_depth, ctx.iterations.back().depth);
+        EXPECT_EQ(move_r, ctx.iterations.back().move_r); EXPECT_EQ(move_c, ctx.iterations.back().move_c);
+    }
+}
+
+TEST_F(RenjuAINegamaxTest, ponder) {
+
+    memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000200100000000000000122200000000000000011200000000000000001210000000000000000200200000000000000110000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
+    RenjuAPI::gsFromString(gs_string, gs);
+
+    // Pondering runs until stopped, then reports the predicted reply and the answer to it
+    std::atomic<bool> stop(false);
+    ctx.stop = &stop;
+    int predicted_r, predicted_c, actual_depth, move_r, move_c;
+    std::thread thread([&] {
+        RenjuAIController::ponder(&ctx, gs, 1, 1, &predicted_r, &predicted_c, &actual_depth, &move_r, &move_c);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    stop = true;
+    thread.join();
+
+    ASSERT_TRUE(predicted_r >= 0 && predicted_r < 19 && predicted_c >= 0 && predicted_c < 19);
+    EXPECT_EQ(0, gs[19 * predicted_r + predicted_c]);
+    ASSERT_TRUE(move_r >= 0 && move_r < 19 && move_c >= 0 && move_c < 19);
+    EXPECT_EQ(0, gs[19 * move_r + move_c]);
+    EXPECT_FALSE(move_r == predicted_r && move_c == predicted_c);
+    EXPECT_GE(actual_depth, 6);
+}
+
+TEST_F(RenjuAINegamaxTest, searchMovesOrdered) {
+    memcpy(gs_string, "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000200100000000000000122221000000000000011220000000000000001210000000000000001200200000000000011112000000000000002000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000", 362);
+    RenjuAPI::gsFromString(gs_string, gs);
+    ctx.board.load(gs);
+
+    RenjuAIMoveList *all = &ctx.plies[0].moves_player, *top = &ctx.plies[0].moves_opponent;
+    for (int player = 1; player <= 2; ++player) {
+        int count = RenjuAINegamax::searchMovesOrdered(&ctx, player, all);
+        ASSERT_EQ(count, all->size());
+
+        // Full ordering: descending heuristic, ties in row-major order
+        for (int i = 1; i < all->size(); ++i) {
+            const RenjuAIMove &a = (*all)[i - 1], &b = (*all)[i];
+            ASSERT_GE(a.heuristic_val, b.heuristic_val);
+            if (a.heuristic_val == b.heuristic_val) {
+                ASSERT_LT(19 * a.r + a.c, 19 * b.r + b.c);
+            }
+        }
+
+        // Bounded selection returns the same prefix
+        for (int limit = 1; limit <= 17; ++limit) {
+            EXPECT_EQ(count, RenjuAINegamax::searchMovesOrdered(&ctx, player, top, limit));
+            ASSERT_EQ(std::min(limit, count), top->size());
+            for (int i = 0; i < top->size(); ++i) {
+                EXPECT_EQ((*all)[i].r, (*top)[i].r);
+                EXPECT_EQ((*all)[i].c, (*top)[i].c);
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <ai/transposition_table.h>
+#include <ai/utils.h>
+
+TEST(RenjuAITranspositionTableTest, storeAndProbe) {
+    RenjuAITranspositionTable tt;
+    RenjuAITranspositionTable::Entry e;
+
+    // Disabled table
+    tt.store(1, 4, 4, RenjuAITranspositionTable::kBoundExact, 100, 7, 7);
+    EXPECT_FALSE(tt.probe(1, &e));
+
+    tt.resize(1);
+    EXPECT_TRUE(tt.enabled());
+    EXPECT_FALSE(tt.probe(1, &e));
+
+    tt.store(1, 6, 4, RenjuAITranspositionTable::kBoundExact, 100, 7, 8);
+    ASSERT_TRUE(tt.probe(1, &e));
+    EXPECT_EQ(100, e.score); EXPECT_EQ(4, e.depth); EXPECT_EQ(6, e.initial_depth);
+    EXPECT_EQ(7, e.move_r); EXPECT_EQ(8, e.move_c);
+    EXPECT_EQ(RenjuAITranspositionTable::kBoundExact, e.bound);
+
+    // Shallower results of the same iteration, or results of a shallower iteration,
+    // do not replace those of the same position
+    tt.store(1, 6, 2, RenjuAITranspositionTable::kBoundLower, 50, 1, 1);
+    tt.store(1, 4, 4, RenjuAITranspositionTable::kBoundLower, 50, 1, 1);
+    ASSERT_TRUE(tt.probe(1, &e));
+    EXPECT_EQ(100, e.score); EXPECT_EQ(4, e.depth); EXPECT_EQ(6, e.initial_depth);
+
+    tt.store(1, 8, 2, RenjuAITranspositionTable::kBoundLower, 50, 1, 1);
+    ASSERT_TRUE(tt.probe(1, &e));
+    EXPECT_EQ(50, e.score); EXPECT_EQ(2, e.depth); EXPECT_EQ(8, e.initial_depth);
+    EXPECT_EQ(RenjuAITranspositionTable::kBoundLower, e.bound);
+
+    tt.store(1, 16, 6, RenjuAITranspositionTable::kBoundUpper, -50, 1, 1);
+    ASSERT_TRUE(tt.probe(1, &e));
+    EXPECT_EQ(-50, e.score); EXPECT_EQ(6, e.depth); EXPECT_EQ(16, e.initial_depth);
+    EXPECT_EQ(RenjuAITranspositionTable::kBoundUpper, e.bound);
+
+    tt.clear();
+    EXPECT_FALSE(tt.probe(1, &e));
+
+    tt.resize(0);
+    EXPECT_FALSE(tt.enabled());
+}
+
+TEST(RenjuAITranspositionTableTest, zobristToggle) {
+    uint64_t z1[225], z2[225];
+    char gs[225] = {0};
+    RenjuAIUtils::zobristInit(225, z1, z2);
+
+    uint64_t hash = RenjuAIUtils::zobristHash(gs, 225, z1, z2);
+    RenjuAIUtils::zobristToggle(&hash, z1, z2, 15, 7, 7, 1);
+    RenjuAIUtils::zobristToggle(&hash, z1, z2, 15, 7, 8, 2);
+    gs[15 * 7 + 7] = 1; gs[15 * 7 + 8] = 2;
+    EXPECT_EQ(RenjuAIUtils::zobristHash(gs, 225, z1, z2), hash);
+
+    RenjuAIUtils::zobristToggle(&hash, z1, z2, 15, 7, 8, 2);
+    gs[15 * 7 + 8] = 0;
+    EXPECT_EQ(RenjuAIUtils::zobristHash(gs, 225, z1, z2), hash);
+}
@@ -0,0 +1,126 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <gtest/gtest.h>
+#include <api/blupig.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Records the depths of completed iterations, stopping after stop_depth
+struct IterationLog {
+    std::vector<int> depths;
+    int stop_depth;
+};
+
+static int logIteration(void *user_data, int depth, int, int, int) {
+    IterationLog *log = static_cast<IterationLog *>(user_data);
+    log->depths.push_back(depth);
+    return depth >= log->stop_depth;
+}
+
+TEST(BlupigTest, search) {
+    EXPECT_EQ(BLUPIG_API_VERSION, blupig_api_version());
+    EXPECT_EQ(nullptr, blupig_create(4));
+
+    blupig_engine *engine = blupig_create(15);
+    ASSERT_NE(nullptr, engine);
+    EXPECT_EQ(BLUPIG_OK, blupig_set_option(engine, BLUPIG_OPTION_TT_SIZE, 1));
+    EXPECT_EQ(BLUPIG_ERROR_INVALID_ARGUMENT, blupig_set_option(engine, BLUPIG_OPTION_THREADS, 0));
+    EXPECT_EQ(BLUPIG_ERROR_INVALID_ARGUMENT, blupig_set_option(engine, 100, 1));
+
+    // Iterative deepening stopped by the callback after the depth 8 iteration
+    blupig_result result;
+    IterationLog log = {{}, 8};
+    ASSERT_EQ(BLUPIG_OK, blupig_search(engine, "h8i9h9", BLUPIG_STATE_MOVES, 2, logIteration, &log, &result));
+    EXPECT_EQ((std::vector<int>{6, 8}), log.depths);
+    EXPECT_EQ(8, result.search_depth);
+    EXPECT_TRUE(result.move_r >= 0 && result.move_r < 15 && result.move_c >= 0 && result.move_c < 15);
+    EXPECT_GT(result.node_count, 0u);
+
+    // Fixed depth, the same engine continuing the game
+    EXPECT_EQ(BLUPIG_OK, blupig_set_option(engine, BLUPIG_OPTION_SEARCH_DEPTH, 4));
+    ASSERT_EQ(BLUPIG_OK, blupig_search(engine, "h8i9h9h10", BLUPIG_STATE_MOVES, 1, nullptr, nullptr, &result));
+    EXPECT_EQ(4, result.search_depth);
+    EXPECT_EQ(0, result.winning_player);
+
+    EXPECT_EQ(BLUPIG_ERROR_INVALID_STATE, blupig_search(engine, "h8h8", BLUPIG_STATE_MOVES, 1, nullptr, nullptr,
+                                                        &result));
+    EXPECT_EQ(BLUPIG_ERROR_INVALID_ARGUMENT, blupig_search(engine, "h8", BLUPIG_STATE_MOVES, 3, nullptr, nullptr,
+                                                           &result));
+    blupig_destroy(engine);
+}
+
+TEST(BlupigTest, stopBeforeSearch) {
+    blupig_engine *engine = blupig_create(15);
+    ASSERT_NE(nullptr, engine);
+
+    // A stop requested between searches ends the next one before any iteration completes
+    blupig_result result;
+    IterationLog log = {{}, 10};
+    blupig_stop(engine);
+    ASSERT_EQ(BLUPIG_OK, blupig_search(engine, "h8i9h9", BLUPIG_STATE_MOVES, 2, logIteration, &log, &result));
+    EXPECT_TRUE(log.depths.empty());
+    EXPECT_EQ(-1, result.move_r);
+    EXPECT_EQ(-1, result.move_c);
+    EXPECT_EQ(0, result.search_depth);
+
+    // The stop has been used up, the following search runs normally
+    log.stop_depth = 6;
+    ASSERT_EQ(BLUPIG_OK, blupig_search(engine, "h8i9h9", BLUPIG_STATE_MOVES, 2, logIteration, &log, &result));
+    EXPECT_EQ((std::vector<int>{6}), log.depths);
+    EXPECT_EQ(6, result.search_depth);
+    EXPECT_TRUE(result.move_r >= 0 && result.move_r < 15 && result.move_c >= 0 && result.move_c < 15);
+    blupig_destroy(engine);
+}
+
+TEST(BlupigTest, stopAtSearchEnd) {
+    blupig_engine *engine = blupig_create(15);
+    ASSERT_NE(nullptr, engine);
+    EXPECT_EQ(BLUPIG_OK, blupig_set_option(engine, BLUPIG_OPTION_SEARCH_DEPTH, 4));
+    EXPECT_EQ(BLUPIG_OK, blupig_set_option(engine, BLUPIG_OPTION_TT_SIZE, 0));
+
+    // Stops land before, during and after the end of a search of about 2ms. A stop is never lost: one
+    // requested after the search returned ends the next search, and the one after that runs normally
+    blupig_result result;
+    for (int i = 0; i < 40; i++) {
+        std::atomic<bool> returned(false);
+        bool stopped_after_return = false;
+        std::thread stopper([&] {
+            std::this_thread::sleep_for(std::chrono::microseconds(i * 50));
+            stopped_after_return = returned.load();
+            blupig_stop(engine);
+        });
+        ASSERT_EQ(BLUPIG_OK, blupig_search(engine, "h8i9h9", BLUPIG_STATE_MOVES, 2, nullptr, nullptr, &result));
+        returned.store(true);
+        stopper.join();
+
+        ASSERT_EQ(BLUPIG_OK, blupig_search(engine, "h8i9h9", BLUPIG_STATE_MOVES, 2, nullptr, nullptr, &result));
+        if (stopped_after_return) {
+            EXPECT_EQ(-1, result.move_r);
+            EXPECT_EQ(0, result.search_depth);
+        }
+
+        ASSERT_EQ(BLUPIG_OK, blupig_search(engine, "h8i9h9", BLUPIG_STATE_MOVES, 2, nullptr, nullptr, &result));
+        EXPECT_TRUE(result.move_r >= 0 && result.move_r < 15 && result.move_c >= 0 && result.move_c < 15);
+        EXPECT_EQ(4, result.search_depth);
+    }
+    blupig_destroy(engine);
+}
@@ -0,0 +1,101 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <gtest/gtest.h>
+#include <ai/search_context.h>
+#include <ai/transposition_table.h>
+#include <api/renju_api.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST(RenjuAPITest, generateMovesInOrder) {
+    // Results of the shared table depend on scheduling, search each position on its own
+    RenjuAPI::setTranspositionTableSize(0);
+
+    static const int moves[][2] = {{7, 7}, {7, 8}, {8, 8}, {6, 6}, {8, 7}, {9, 9}, {6, 8}, {8, 6}, {5, 9}, {9, 7}};
+    std::vector<RenjuAPIMoveRequest> requests;
+    std::string gs(225, '0');
+    for (int i = 0; i < 10; ++i) {
+        gs[15 * moves[i][0] + moves[i][1]] = static_cast<char>('1' + i % 2);
+        RenjuAPIMoveRequest request;
+        request.gs_string = gs;
+        request.ai_player_id = (i + 1) % 2 + 1;
+        request.search_depth = 4;
+        requests.push_back(request);
+    }
+
+    // Invalid requests fail without affecting the others
+    requests[3].gs_string.resize(100);
+    requests[6].ai_player_id = 3;
+
+    std::vector<RenjuAPIMoveResult> results(requests.size());
+    RenjuAPI::generateMoves(requests.data(), requests.size(), results.data(), 4);
+
+    std::unique_ptr<RenjuAISearchContext> ctx;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        RenjuAPIMoveResult expected;
+        RenjuAPI::generateMove(requests[i], &expected, &ctx);
+        EXPECT_EQ(expected.success, results[i].success);
+        if (!expected.success) continue;
+
+        EXPECT_EQ(expected.move_r, results[i].move_r);
+        EXPECT_EQ(expected.move_c, results[i].move_c);
+        EXPECT_EQ(expected.node_count, results[i].node_count);
+        EXPECT_EQ(expected.actual_depth, results[i].actual_depth);
+    }
+    EXPECT_FALSE(results[3].success);
+    EXPECT_FALSE(results[6].success);
+
+    RenjuAPI::setTranspositionTableSize(kRenjuAiTTDefaultSizeMB);
+}
+
+TEST(RenjuAPITest, stateFormats) {
+    // The same position as digits, packed and a move list
+    std::string digits(225, '0');
+    digits[15 * 7 + 7] = '1'; digits[15 * 7 + 8] = '2'; digits[15 * 8 + 8] = '1'; digits[15 * 14 + 14] = '2';
+    char expected[225], gs[225];
+    ASSERT_TRUE(RenjuAPI::parseGameState(digits, kRenjuAPIStateDigits, 15, expected));
+    EXPECT_EQ(digits, RenjuAPI::formatGameState(expected, 15, kRenjuAPIStateDigits));
+
+    std::string packed = RenjuAPI::formatGameState(expected, 15, kRenjuAPIStatePacked);
+    EXPECT_EQ(76u, packed.size());
+    ASSERT_TRUE(RenjuAPI::parseGameState(packed, kRenjuAPIStatePacked, 15, gs));
+    EXPECT_EQ(0, memcmp(expected, gs, 225));
+
+    ASSERT_TRUE(RenjuAPI::parseGameState("h8i8i9o15", kRenjuAPIStateMoves, 15, gs));
+    EXPECT_EQ(0, memcmp(expected, gs, 225));
+
+    // Malformed states
+    EXPECT_FALSE(RenjuAPI::parseGameState(digits.substr(1), kRenjuAPIStateDigits, 15, gs));
+    EXPECT_FALSE(RenjuAPI::parseGameState(packed.substr(1), kRenjuAPIStatePacked, 15, gs));
+    EXPECT_FALSE(RenjuAPI::parseGameState(packed + "A", kRenjuAPIStatePacked, 15, gs));
+    EXPECT_FALSE(RenjuAPI::parseGameState("h8h8", kRenjuAPIStateMoves, 15, gs));
+    EXPECT_FALSE(RenjuAPI::parseGameState("h16", kRenjuAPIStateMoves, 15, gs));
+    EXPECT_FALSE(RenjuAPI::parseGameState("p1", kRenjuAPIStateMoves, 15, gs));
+    EXPECT_FALSE(RenjuAPI::parseGameState("h", kRenjuAPIStateMoves, 15, gs));
+    EXPECT_EQ(-1, RenjuAPI::stateFormatFromName("hex"));
+
+    // Cells set to 3 are rejected
+    std::vector<unsigned char> data;
+    RenjuAPI::gsToPacked(expected, 15, &data);
+    data[0] |= 3;
+    EXPECT_FALSE(RenjuAPI::gsFromPacked(data.data(), data.size(), 15, gs));
+}
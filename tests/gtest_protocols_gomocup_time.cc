@@ -0,0 +1,79 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <protocols/gomocup_time.h>
+
+TEST(RenjuProtocolGomocupTimeTest, turnTimeLimit) {
+    RenjuProtocolGomocupTime time;
+    EXPECT_FALSE(time.setInfo("rule", 1));
+
+    // Keys are matched whole, not by prefix
+    EXPECT_FALSE(time.setInfo("timeout_turn_extra", 1));
+    EXPECT_FALSE(time.setInfo("time_left2", 1));
+    EXPECT_FALSE(time.setInfo("timeout", 1));
+
+    // Per-turn limit only, with a margin for I/O
+    EXPECT_TRUE(time.setInfo("timeout_turn", 5000));
+    EXPECT_EQ(5000 - kGomocupTimeMargin, time.turnTimeLimit(0));
+    EXPECT_EQ(5000 - kGomocupTimeMargin, time.turnTimeLimit(100));
+
+    // Tiny turn limits keep most of the turn, zero means as fast as possible
+    time.setInfo("timeout_turn", 200);
+    EXPECT_EQ(150, time.turnTimeLimit(0));
+    time.setInfo("timeout_turn", 0);
+    EXPECT_EQ(0, time.turnTimeLimit(0));
+
+    // The match time is split across the expected remaining moves
+    time.setInfo("timeout_turn", 30000);
+    time.setInfo("timeout_match", 180000);
+    int first = time.turnTimeLimit(0);
+    EXPECT_EQ((180000 - kGomocupTimeMargin) / kGomocupTimeExpectedMoves, first);
+    EXPECT_GT(time.turnTimeLimit(20), first);
+    EXPECT_EQ((180000 - kGomocupTimeMargin) / kGomocupTimeMinMovesLeft, time.turnTimeLimit(100));
+
+    // Time spent is charged until the manager reports time_left again
+    time.moveFinished(80000);
+    EXPECT_EQ((100000 - kGomocupTimeMargin) / kGomocupTimeExpectedMoves, time.turnTimeLimit(0));
+    time.setInfo("time_left", 40000);
+    EXPECT_EQ((40000 - kGomocupTimeMargin) / kGomocupTimeExpectedMoves, time.turnTimeLimit(0));
+
+    // The per-turn cap still applies, and an exhausted match never yields a negative budget
+    time.setInfo("time_left", 10000000);
+    EXPECT_EQ(30000 - kGomocupTimeMargin, time.turnTimeLimit(0));
+    time.setInfo("time_left", 0);
+    EXPECT_EQ(0, time.turnTimeLimit(0));
+
+    // Unlimited match
+    time.setInfo("timeout_match", 0);
+    EXPECT_EQ(30000 - kGomocupTimeMargin, time.turnTimeLimit(0));
+}
+
+TEST(RenjuProtocolGomocupTimeTest, transpositionTableSize) {
+    RenjuProtocolGomocupTime time;
+    EXPECT_EQ(-1, time.transpositionTableSize());
+
+    time.setInfo("max_memory", 350LL << 20);
+    EXPECT_EQ(175, time.transpositionTableSize());
+
+    time.setInfo("max_memory", 64LL << 30);
+    EXPECT_EQ(4096, time.transpositionTableSize());
+
+    time.setInfo("max_memory", 0);
+    EXPECT_EQ(-1, time.transpositionTableSize());
+}
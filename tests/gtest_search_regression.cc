@@ -0,0 +1,138 @@
+/*
+ * blupig
+ * Copyright (C) 2016-2017 Yunzhu Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Search regression harness: searches every corpus position in the two reproducible modes
+// (fixed depth, and iterative deepening bounded by nodes) and compares the best move and
+// counters with tests/data/search_baseline.json. Optimizations that must not change the
+// search keep these identical; intended changes regenerate the baseline with
+//   BLUPIG_UPDATE_BASELINE=1 ./gomoku_test --gtest_filter=RenjuSearchRegressionTest.*
+
+#include <gtest/gtest.h>
+#include <ai/search_context.h>
+#include <api/renju_api.h>
+#include <data/corpus.h>
+#include <utils/json.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+// Node budget of the node-limited mode
+#define kRenjuRegressionNodeLimit 20000
+
+static const char kBaselinePath[] = BLUPIG_TEST_DATA_DIR "/search_baseline.json";
+
+// Search a corpus position on one thread with a cleared transposition table
+static nlohmann::json searchPosition(const RenjuCorpusPosition &position, bool node_limited) {
+    RenjuAPI::setTranspositionTableSize(kRenjuAiTTDefaultSizeMB);
+
+    RenjuAPIMoveRequest request;
+    request.gs_string = position.state;
+    request.state_format = position.state_format;
+    request.board_size = position.board_size;
+    request.ai_player_id = position.player;
+    request.search_depth = node_limited ? -1 : position.search_depth;
+    request.node_limit = node_limited ? kRenjuRegressionNodeLimit : 0;
+    request.num_threads = 1;
+
+    RenjuAPIMoveResult result;
+    std::unique_ptr<RenjuAISearchContext> ctx;
+    RenjuAPI::generateMove(request, &result, &ctx);
+
+    nlohmann::json record;
+    record["name"] = position.name;
+    record["mode"] = node_limited ? "nodes" : "depth";
+    record["success"] = result.success;
+    record["depth"] = result.actual_depth;
+    record["move_r"] = result.move_r;
+    record["move_c"] = result.move_c;
+    record["node_count"] = result.node_count;
+    record["eval_count"] = result.eval_count;
+    record["pm_count"] = result.pm_count;
+    return record;
+}
+
+// The transposition table only saves work: at a fixed depth every corpus position gets the same
+// move and score without it, with an empty table, and with a table left by a shallower search
+// (as in iterative deepening)
+TEST(RenjuSearchRegressionTest, transpositionTable) {
+    for (int i = 0; i < kRenjuCorpusSize; ++i) {
+        const RenjuCorpusPosition &position = kRenjuCorpus[i];
+        SCOPED_TRACE(position.name);
+
+        RenjuAPIMoveRequest request;
+        request.gs_string = position.state;
+        request.state_format = position.state_format;
+        request.board_size = position.board_size;
+        request.ai_player_id = position.player;
+
+        RenjuAPIMoveResult results[3];
+        for (int k = 0; k < 3; ++k) {
+            ASSERT_TRUE(RenjuAPI::setTranspositionTableSize(k == 0 ? 0 : kRenjuAiTTDefaultSizeMB));
+            std::unique_ptr<RenjuAISearchContext> ctx;
+            if (k == 2) {
+                request.search_depth = position.search_depth - 2;
+                RenjuAPI::generateMove(request, &results[k], &ctx);
+            }
+            request.search_depth = position.search_depth;
+            RenjuAPI::generateMove(request, &results[k], &ctx);
+            ASSERT_TRUE(results[k].success);
+            ASSERT_EQ(1u, results[k].iterations.size());
+        }
+
+        for (int k = 1; k < 3; ++k) {
+            EXPECT_EQ(results[0].move_r, results[k].move_r) << k;
+            EXPECT_EQ(results[0].move_c, results[k].move_c) << k;
+            EXPECT_EQ(results[0].iterations[0].score, results[k].iterations[0].score) << k;
+        }
+    }
+}
+
+TEST(RenjuSearchRegressionTest, corpus) {
+    nlohmann::json records = nlohmann::json::array();
+    for (int i = 0; i < kRenjuCorpusSize; ++i) {
+        records.push_back(searchPosition(kRenjuCorpus[i], false));
+        records.push_back(searchPosition(kRenjuCorpus[i], true));
+    }
+
+    const char *update = getenv("BLUPIG_UPDATE_BASELINE");
+    if (update != nullptr && strcmp(update, "1") == 0) {
+        std::ofstream file(kBaselinePath);
+        file << records.dump(2) << std::endl;
+        ASSERT_TRUE(file.good()) << "Cannot write " << kBaselinePath;
+        return;
+    }
+
+    nlohmann::json baseline;
+    std::ifstream file(kBaselinePath);
+    ASSERT_TRUE(file.good()) << "Cannot read " << kBaselinePath;
+    file >> baseline;
+    ASSERT_EQ(baseline.size(), records.size()) << "The corpus changed, regenerate the baseline";
+
+    // Report every differing field of every position
+    for (size_t i = 0; i < records.size(); ++i) {
+        const nlohmann::json &expected = baseline[i], &actual = records[i];
+        SCOPED_TRACE(actual["name"].get<std::string>() + " (" + actual["mode"].get<std::string>() + ")");
+        for (auto it = expected.begin(); it != expected.end(); ++it) {
+            // Compared as text: gtest cannot print JSON values itself
+            EXPECT_EQ(it.value().dump(), actual[it.key()].dump()) << it.key();
+        }
+    }
+}